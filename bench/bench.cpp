@@ -0,0 +1,273 @@
+// ray-bench: renders a fixed set of scenes headlessly with fixed seeds,
+// resolution and sample count and prints one JSON object per scene.
+//
+// usage: ray-bench [--scene name] [--width w] [--height h] [--spp n] [--seed s]
+//                  [--bsp file] [--obj file] [--hdr file] [--lights power|spatial]
+//                  [--max-depth n] [--min-depth n] [--roulette throughput|efficiency]
+//                  [--texture-filter nearest|bilinear|trilinear]
+//                  [--env-format float|half|rgbe] [--env-mapping latlong|octahedral]
+//                  [--env-cache 0|1]
+
+#include "Tracer.h"
+#include "Scene.h"
+#include "Quad.h"
+#include "Sphere.h"
+#include "Plane.h"
+#include "Mesh.h"
+#include "EnvironmentMap.h"
+#include "Material.h"
+#include "Prng.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+extern long long thread_num_rays[];
+
+struct BenchSettings {
+	int width = 256;
+	int height = 256;
+	int spp = 16;
+	unsigned int seed = 1;
+	std::string bsp = "demo1.bsp";
+	std::string obj = "model.obj";
+	std::string hdr = "sky.hdr";
+	LightSelection lights = LightSelection::Spatial;
+	RenderSettings render;
+	EnvironmentOptions env;
+};
+
+// Peak resident memory of the whole process so far. It never goes down, so
+// a scene reports the largest footprint of itself and every scene before it.
+long processPeakRssKb() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+	return (long)(pmc.PeakWorkingSetSize / 1024);
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+#endif
+}
+
+bool fileExists(const std::string& filename) {
+	return std::ifstream(filename).good();
+}
+
+// The default scene is the cornell box, nothing to do.
+bool setupCornell(Tracer& tracer, const BenchSettings& settings) {
+	return true;
+}
+
+bool setupBsp(Tracer& tracer, const BenchSettings& settings) {
+	if (!fileExists(settings.bsp)) return false;
+
+	tracer.scene.clear();
+	auto mesh = new Mesh(settings.bsp);
+	tracer.scene.add(mesh);
+	tracer.camera.position = (mesh->bounds.min + mesh->bounds.max) * 0.5f;
+	return true;
+}
+
+// Views the model from in front of its bounds, lit by the sky.
+bool setupObj(Tracer& tracer, const BenchSettings& settings) {
+	if (!fileExists(settings.obj)) return false;
+
+	tracer.scene.clear();
+	Mesh* mesh;
+	try {
+		mesh = new Mesh(settings.obj);
+	}
+	catch (const std::exception& e) {
+		fprintf(stderr, "%s: %s\n", settings.obj.c_str(), e.what());
+		return false;
+	}
+	tracer.scene.add(mesh);
+	auto extent = mesh->bounds.max - mesh->bounds.min;
+	tracer.camera.position = (mesh->bounds.min + mesh->bounds.max) * 0.5f - Vec3(0, 0, std::max(extent.x, extent.y) * 0.5f + extent.z);
+	return true;
+}
+
+bool setupSpheres(Tracer& tracer, const BenchSettings& settings) {
+	auto& scene = tracer.scene;
+	scene.clear();
+
+	Prng prng(settings.seed);
+	scene.add(Plane(Vec3(0, -1, 0), Vec3(0, 1, 0), g_materials.add(Material(Vec3(0.8, 0.8, 0.8)))));
+	for (int z = 0; z < 32; z++) {
+		for (int x = 0; x < 32; x++) {
+			auto color = Vec3(prng.frand(0.1, 0.9), prng.frand(0.1, 0.9), prng.frand(0.1, 0.9));
+			float roughness = prng.frand(0, 0.5);
+			float metallic = prng.frand(0, 1) > 0.7f ? 1.0f : 0.0f;
+			float opacity = prng.frand(0, 1) > 0.9f ? 0.0f : 1.0f;
+			auto center = Vec3(x * 0.25f - 4, -0.9f, z * 0.25f - 2) + Vec3(prng.frand(-0.05, 0.05), 0, prng.frand(-0.05, 0.05));
+			scene.add(Sphere(center, 0.1f, g_materials.add(Material(color, Vec3(0, 0, 0), roughness, opacity, metallic))));
+		}
+	}
+
+	auto light = scene.add(Quad(Vec3(-1, 2, -1), Vec3(2, 0, 0), Vec3(0, 0, 2), g_materials.add(Material(Vec3(0, 0, 0), Vec3(10, 10, 10)))));
+	scene.addLight(light);
+	return true;
+}
+
+// The spheres scene with every sphere moving while the shutter is open.
+bool setupMotion(Tracer& tracer, const BenchSettings& settings) {
+	setupSpheres(tracer, settings);
+	Prng prng(settings.seed + 1);
+	for (auto& sphere : tracer.scene.spheres) {
+		sphere.motion = Vec3(prng.frand(-0.2, 0.2), prng.frand(0, 0.3), prng.frand(-0.2, 0.2));
+	}
+	return true;
+}
+
+bool setupEnvMap(Tracer& tracer, const BenchSettings& settings) {
+	if (!fileExists(settings.hdr)) return false;
+
+	auto& scene = tracer.scene;
+	scene.clear();
+
+	try {
+		scene.envMap = EnvironmentMap::load(settings.hdr, settings.env);
+	}
+	catch (const std::exception& e) {
+		fprintf(stderr, "%s: %s\n", settings.hdr.c_str(), e.what());
+		return false;
+	}
+	scene.add(Plane(Vec3(0, -1, 0), Vec3(0, 1, 0), g_materials.addChecker(
+		Material(Vec3(0.3, 0.3, 0.3), Vec3(0, 0, 0), 0.0002f, 1, 1),
+		Material(Vec3(0.3, 0.3, 0.3), Vec3(0, 0, 0), 0.00002f, 1, 1)
+	)));
+	scene.add(Sphere(Vec3(-1, 0, 0), 1, g_materials.add(Material(Vec3(0.9, 0.9, 0.9)))));
+	scene.add(Sphere(Vec3(1, 0, 0), 1, g_materials.add(Material(Vec3(0.9, 0.6, 0.3), Vec3(0, 0, 0), 0.1f, 1, 1))));
+	return true;
+}
+
+struct BenchScene {
+	const char* name;
+	bool (*setup)(Tracer& tracer, const BenchSettings& settings);
+};
+
+const BenchScene benchScenes[] = {
+	{ "cornell", setupCornell },
+	{ "bsp", setupBsp },
+	{ "obj", setupObj },
+	{ "spheres", setupSpheres },
+	{ "motion", setupMotion },
+	{ "envmap", setupEnvMap },
+};
+
+void runScene(const BenchScene& bench, const BenchSettings& settings) {
+	Tracer tracer;
+	if (!bench.setup(tracer, settings)) {
+		printf("{\"scene\":\"%s\",\"skipped\":true}\n", bench.name);
+		fflush(stdout);
+		return;
+	}
+
+	tracer.scene.lightSelection = settings.lights;
+	tracer.settings = settings.render;
+	tracer.resize(settings.width, settings.height);
+	tracer.seed(settings.seed);
+	for (int i = 0; i < numThreads; i++) thread_num_rays[i] = 0;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < settings.spp; i++) {
+		tracer.sample();
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	double seconds = std::chrono::duration<double>(end - start).count();
+
+	long long rays = 0;
+	for (int i = 0; i < numThreads; i++) rays += thread_num_rays[i];
+
+	Vec3 sum(0, 0, 0);
+	for (int i = 0; i < tracer.width * tracer.height; i++) sum += tracer.buffer[i];
+	double mean = (sum.x + sum.y + sum.z) / (3.0 * tracer.width * tracer.height * tracer.numSamples);
+
+	printf(
+		"{\"scene\":\"%s\",\"width\":%d,\"height\":%d,\"spp\":%d,\"seed\":%u,\"threads\":%d,\"lights\":\"%s\","
+		"\"max_depth\":%d,\"min_depth\":%d,\"roulette\":\"%s\","
+		"\"rays\":%lld,\"seconds\":%.4f,\"mrays_per_s\":%.3f,\"ms_per_sample\":%.3f,\"mean_radiance\":%.6f,\"process_peak_rss_kb\":%ld}\n",
+		bench.name, settings.width, settings.height, settings.spp, settings.seed, numThreads,
+		settings.lights == LightSelection::Power ? "power" : "spatial",
+		settings.render.maxDepth, settings.render.minDepth,
+		settings.render.roulette == RouletteStrategy::Efficiency ? "efficiency" : "throughput",
+		rays, seconds, rays / seconds / 1e6, seconds * 1000 / settings.spp, mean, processPeakRssKb()
+	);
+	fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+	BenchSettings settings;
+	std::string only;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (i + 1 >= argc) {
+			fprintf(stderr, "missing value for %s\n", arg.c_str());
+			return 1;
+		}
+		std::string value = argv[++i];
+		try {
+			if (arg == "--scene") only = value;
+			else if (arg == "--width") settings.width = std::stoi(value);
+			else if (arg == "--height") settings.height = std::stoi(value);
+			else if (arg == "--spp") settings.spp = std::stoi(value);
+			else if (arg == "--seed") settings.seed = std::stoul(value);
+			else if (arg == "--bsp") settings.bsp = value;
+			else if (arg == "--obj") settings.obj = value;
+			else if (arg == "--hdr") settings.hdr = value;
+			else if (arg == "--lights" && value == "power") settings.lights = LightSelection::Power;
+			else if (arg == "--lights" && value == "spatial") settings.lights = LightSelection::Spatial;
+			else if (arg == "--max-depth") settings.render.maxDepth = std::stoi(value);
+			else if (arg == "--min-depth") settings.render.minDepth = std::stoi(value);
+			else if (arg == "--roulette" && value == "throughput") settings.render.roulette = RouletteStrategy::Throughput;
+			else if (arg == "--roulette" && value == "efficiency") settings.render.roulette = RouletteStrategy::Efficiency;
+			else if (arg == "--texture-filter" && value == "nearest") g_materials.filter = TextureFilter::Nearest;
+			else if (arg == "--texture-filter" && value == "bilinear") g_materials.filter = TextureFilter::Bilinear;
+			else if (arg == "--texture-filter" && value == "trilinear") g_materials.filter = TextureFilter::Trilinear;
+			else if (arg == "--env-format" && value == "float") settings.env.format = EnvFormat::Float;
+			else if (arg == "--env-format" && value == "half") settings.env.format = EnvFormat::Half;
+			else if (arg == "--env-format" && value == "rgbe") settings.env.format = EnvFormat::Rgbe;
+			else if (arg == "--env-mapping" && value == "latlong") settings.env.mapping = EnvMapping::LatLong;
+			else if (arg == "--env-mapping" && value == "octahedral") settings.env.mapping = EnvMapping::Octahedral;
+			else if (arg == "--env-cache") settings.env.cache = std::stoi(value) != 0;
+			else {
+				fprintf(stderr, "unknown option %s\n", arg.c_str());
+				return 1;
+			}
+		}
+		catch (const std::logic_error&) {
+			// std::stoi and friends on a malformed or out of range number
+			fprintf(stderr, "bad value for %s: %s\n", arg.c_str(), value.c_str());
+			return 1;
+		}
+	}
+
+	bool found = false;
+	for (auto& bench : benchScenes) {
+		if (!only.empty() && only != bench.name) continue;
+		found = true;
+		runScene(bench, settings);
+	}
+
+	if (!found) {
+		fprintf(stderr, "unknown scene %s\n", only.c_str());
+		return 1;
+	}
+
+	return 0;
+}
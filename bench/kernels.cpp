@@ -0,0 +1,176 @@
+// ray-microbench: times the individual intersection kernels in isolation
+// with randomized and coherent ray distributions and prints one JSON object
+// per kernel and distribution. The batch kernels test 8 primitives per call.
+//
+// usage: ray-microbench [--filter substring] [--rays n] [--iterations n] [--seed s]
+
+#include "Sphere.h"
+#include "Cube.h"
+#include "Quad.h"
+#include "Plane.h"
+#include "Mesh.h"
+#include "Batch.h"
+#include "Material.h"
+#include "Prng.h"
+
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct MicroSettings {
+	int rays = 1 << 16;
+	int iterations = 50;
+	unsigned int seed = 1;
+	std::string filter;
+};
+
+// Rays starting anywhere around the unit cube heading in any direction.
+std::vector<Ray> randomRays(const MicroSettings& settings) {
+	Prng prng(settings.seed);
+	std::vector<Ray> rays;
+	rays.reserve(settings.rays);
+	for (int i = 0; i < settings.rays; i++) {
+		rays.push_back(Ray(prng.randomPointInUnitCube() * 3, prng.randomPointOnUnitSphere()));
+	}
+	return rays;
+}
+
+// Rays from a pinhole camera in front of the unit cube, scanline order.
+std::vector<Ray> coherentRays(const MicroSettings& settings) {
+	Prng prng(settings.seed);
+	std::vector<Ray> rays;
+	rays.reserve(settings.rays);
+	int side = 1;
+	while (side * side < settings.rays) side++;
+	for (int i = 0; i < settings.rays; i++) {
+		float fx = (i % side + prng.frand(0, 1)) / side - 0.5f;
+		float fy = (i / side + prng.frand(0, 1)) / side - 0.5f;
+		rays.push_back(Ray(Vec3(0, 0, -3), normalized(Vec3(fx, fy, 1))));
+	}
+	return rays;
+}
+
+template<typename Kernel>
+void run(const MicroSettings& settings, const char* name, const char* distribution, const std::vector<Ray>& rays, Kernel kernel) {
+	std::string id = std::string(name) + "/" + distribution;
+	if (!settings.filter.empty() && id.find(settings.filter) == std::string::npos) return;
+
+	// warm up caches and branch predictors
+	long long hits = 0;
+	for (auto& ray : rays) hits += kernel(ray);
+
+	hits = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < settings.iterations; i++) {
+		for (auto& ray : rays) hits += kernel(ray);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	double seconds = std::chrono::duration<double>(end - start).count();
+	long long tests = (long long)rays.size() * settings.iterations;
+
+	printf(
+		"{\"kernel\":\"%s\",\"distribution\":\"%s\",\"tests\":%lld,\"hit_rate\":%.4f,\"ns_per_test\":%.3f,\"mtests_per_s\":%.3f}\n",
+		name, distribution, tests, (double)hits / tests, seconds * 1e9 / tests, tests / seconds / 1e6
+	);
+	fflush(stdout);
+}
+
+void runAll(const MicroSettings& settings, const char* distribution, const std::vector<Ray>& rays) {
+	auto material = g_materials.add(Material(Vec3(1, 1, 1)));
+	Sphere sphere(Vec3(0, 0, 0), 1, material);
+	Cube cube(Vec3(0, 0, 0), Vec3(2, 2, 2), material);
+	Quad quad(Vec3(-1, -1, 0), Vec3(2, 0, 0), Vec3(0, 2, 0), material);
+	Plane plane(Vec3(0, 0, 0), normalized(Vec3(0.1f, 0.2f, -1)), material);
+	Vertex v0{ Vec3(-1, -1, 0) };
+	Vertex v1{ Vec3(1, -1, 0) };
+	Vertex v2{ Vec3(0, 1, 0) };
+	AABB aabb;
+	aabb.enclose(Vec3(-1, -1, -1));
+	aabb.enclose(Vec3(1, 1, 1));
+
+	// batches of 8 primitives arranged around the unit cube
+	SphereBatch sphereBatch;
+	QuadBatch quadBatch;
+	for (int i = 0; i < kBatchSize; i++) {
+		auto offset = Vec3((i & 1) - 0.5f, ((i >> 1) & 1) - 0.5f, (i >> 2) - 0.5f);
+		sphereBatch.set(i, Sphere(offset, 0.5f, material), i);
+		quadBatch.set(i, Quad(offset - Vec3(0.5f, 0.5f, 0), Vec3(1, 0, 0), Vec3(0, 1, 0), material), i);
+	}
+	sphereBatch.count = quadBatch.count = kBatchSize;
+
+	run(settings, "Sphere::intersect", distribution, rays, [&](const Ray& ray) {
+		Hit hit;
+		return sphere.intersect(ray, &hit);
+	});
+	run(settings, "Cube::intersect", distribution, rays, [&](const Ray& ray) {
+		Hit hit;
+		return cube.intersect(ray, &hit);
+	});
+	run(settings, "Quad::intersect", distribution, rays, [&](const Ray& ray) {
+		Hit hit;
+		return quad.intersect(ray, &hit);
+	});
+	run(settings, "Plane::intersect", distribution, rays, [&](const Ray& ray) {
+		Hit hit;
+		return plane.intersect(ray, &hit);
+	});
+	run(settings, "rayTriangle", distribution, rays, [&](const Ray& ray) {
+		Hit hit;
+		return rayTriangle(ray, v0, v1, v2, &hit);
+	});
+	run(settings, "Sphere::occluded", distribution, rays, [&](const Ray& ray) {
+		return sphere.occluded(ray, 99999);
+	});
+	run(settings, "Quad::occluded", distribution, rays, [&](const Ray& ray) {
+		return quad.occluded(ray, 99999);
+	});
+	run(settings, "triangleOccludes", distribution, rays, [&](const Ray& ray) {
+		return triangleOccludes(ray, v0, v1, v2, kMinDistance, 99999);
+	});
+	run(settings, "testAABB", distribution, rays, [&](const Ray& ray) {
+		return testAABB(ray, aabb) >= 0;
+	});
+	run(settings, "SphereBatch::intersect", distribution, rays, [&](const Ray& ray) {
+		float tmax = 99999;
+		return sphereBatch.intersect(ray, 0.0001f, tmax) >= 0;
+	});
+	run(settings, "QuadBatch::intersect", distribution, rays, [&](const Ray& ray) {
+		float tmax = 99999;
+		return quadBatch.intersect(ray, 0.0001f, tmax) >= 0;
+	});
+}
+
+int main(int argc, char** argv) {
+	MicroSettings settings;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (i + 1 >= argc) {
+			fprintf(stderr, "missing value for %s\n", arg.c_str());
+			return 1;
+		}
+		std::string value = argv[++i];
+		try {
+			if (arg == "--filter") settings.filter = value;
+			else if (arg == "--rays") settings.rays = std::stoi(value);
+			else if (arg == "--iterations") settings.iterations = std::stoi(value);
+			else if (arg == "--seed") settings.seed = std::stoul(value);
+			else {
+				fprintf(stderr, "unknown option %s\n", arg.c_str());
+				return 1;
+			}
+		}
+		catch (const std::logic_error&) {
+			// std::stoi and friends on a malformed or out of range number
+			fprintf(stderr, "bad value for %s: %s\n", arg.c_str(), value.c_str());
+			return 1;
+		}
+	}
+
+	runAll(settings, "random", randomRays(settings));
+	runAll(settings, "coherent", coherentRays(settings));
+
+	return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef AABB_h
+#define AABB_h
+
+#include "Vec3.h"
+
+struct AABB {
+	Vec3 min = Vec3(99999999);
+	Vec3 max = Vec3(-99999999);
+
+	bool intersects(const AABB& other) const {
+		return
+			min.x <= other.max.x
+			&& min.y <= other.max.y
+			&& min.z <= other.max.z
+			&& max.x >= other.min.x
+			&& max.y >= other.min.y
+			&& max.z >= other.min.z;
+	}
+
+	bool contains(const Vec3& p) const {
+		return
+			p.x >= min.x && p.x <= max.x
+			&& p.y >= min.y && p.y <= max.y
+			&& p.z >= min.z && p.z <= max.z;
+	}
+
+	void enclose(const Vec3& p) {
+		if (p.x > max.x) max.x = p.x;
+		if (p.x < min.x) min.x = p.x;
+		if (p.y > max.y) max.y = p.y;
+		if (p.y < min.y) min.y = p.y;
+		if (p.z > max.z) max.z = p.z;
+		if (p.z < min.z) min.z = p.z;
+	}
+
+	void enclose(const AABB& other) {
+		enclose(other.min);
+		enclose(other.max);
+	}
+
+	Vec3 center() const {
+		return Vec3((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f);
+	}
+
+	float surfaceArea() const {
+		auto e = max - min;
+		if (e.x < 0 || e.y < 0 || e.z < 0) return 0;
+		return 2 * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include "Accumulation.h"
+#include "Tracer.h"
+
+#include <cstdint>
+#include <stdexcept>
+
+namespace {
+
+const uint32_t kMagic = 0x43434152; // "RACC"
+const uint32_t kVersion = 1;
+
+struct Header {
+	uint32_t magic = kMagic;
+	uint32_t version = kVersion;
+	int32_t width = 0;
+	int32_t height = 0;
+	uint32_t ranges = 0;
+};
+
+struct RangeRecord {
+	uint32_t seed = 0;
+	int32_t first = 0;
+	int32_t count = 0;
+};
+
+void fail(const std::string& message) {
+	throw std::runtime_error("accumulation file: " + message);
+}
+
+bool overlaps(const SampleRange& a, const SampleRange& b) {
+	return a.seed == b.seed && a.first < b.first + b.count && b.first < a.first + a.count;
+}
+
+}
+
+int Accumulation::samples() const {
+	int n = 0;
+	for (auto& r : ranges) n += r.count;
+	return n;
+}
+
+void Accumulation::merge(const Accumulation& other) {
+	if (ranges.empty() && sum.empty()) {
+		*this = other;
+		return;
+	}
+	if (other.width != width || other.height != height) {
+		throw std::runtime_error("cannot merge " + std::to_string(other.width) + "x" + std::to_string(other.height)
+			+ " into " + std::to_string(width) + "x" + std::to_string(height));
+	}
+	for (auto& a : other.ranges) {
+		for (auto& b : ranges) {
+			if (overlaps(a, b)) {
+				throw std::runtime_error("samples " + std::to_string(a.first) + "-" + std::to_string(a.first + a.count - 1)
+					+ " of seed " + std::to_string(a.seed) + " merged twice");
+			}
+		}
+	}
+	ranges.insert(ranges.end(), other.ranges.begin(), other.ranges.end());
+	for (size_t i = 0; i < sum.size(); i++) sum[i] += other.sum[i];
+}
+
+Accumulation accumulation(const Tracer& tracer) {
+	Accumulation acc;
+	acc.width = tracer.width;
+	acc.height = tracer.height;
+	if (tracer.numSamples > 0) {
+		SampleRange range;
+		range.seed = tracer.randomSeed;
+		range.first = tracer.firstSample;
+		range.count = tracer.numSamples;
+		acc.ranges.push_back(range);
+	}
+	acc.sum.assign(tracer.buffer, tracer.buffer + size_t(tracer.width) * tracer.height);
+	return acc;
+}
+
+void writeAccumulation(std::ostream& file, const Accumulation& acc) {
+	Header header;
+	header.width = acc.width;
+	header.height = acc.height;
+	header.ranges = uint32_t(acc.ranges.size());
+	file.write((const char*)&header, sizeof(header));
+	for (auto& r : acc.ranges) {
+		RangeRecord record;
+		record.seed = r.seed;
+		record.first = r.first;
+		record.count = r.count;
+		file.write((const char*)&record, sizeof(record));
+	}
+
+	std::vector<float> floats;
+	floats.reserve(acc.sum.size() * 3);
+	for (auto& p : acc.sum) {
+		floats.push_back(p.x);
+		floats.push_back(p.y);
+		floats.push_back(p.z);
+	}
+	file.write((const char*)floats.data(), floats.size() * sizeof(float));
+}
+
+Accumulation readAccumulation(std::istream& file) {
+	Header header;
+	if (!file.read((char*)&header, sizeof(header))) fail("truncated header");
+	if (header.magic != kMagic) fail("not an accumulation file");
+	if (header.version != kVersion) fail("unsupported version " + std::to_string(header.version));
+	if (header.width <= 0 || header.height <= 0 || header.width > 65536 || header.height > 65536) fail("bad image size");
+	if (header.ranges > (1u << 20)) fail("too many sample ranges");
+
+	Accumulation acc;
+	acc.width = header.width;
+	acc.height = header.height;
+	for (uint32_t i = 0; i < header.ranges; i++) {
+		RangeRecord record;
+		if (!file.read((char*)&record, sizeof(record))) fail("truncated sample ranges");
+		if (record.first < 0 || record.count <= 0) fail("bad sample range");
+		SampleRange range;
+		range.seed = record.seed;
+		range.first = record.first;
+		range.count = record.count;
+		acc.ranges.push_back(range);
+	}
+
+	std::vector<float> floats(size_t(acc.width) * acc.height * 3);
+	if (!file.read((char*)floats.data(), floats.size() * sizeof(float))) fail("truncated pixels");
+	acc.sum.resize(size_t(acc.width) * acc.height);
+	for (size_t i = 0; i < acc.sum.size(); i++) {
+		acc.sum[i] = Vec3(floats[i * 3], floats[i * 3 + 1], floats[i * 3 + 2]);
+	}
+	return acc;
+}
@@ -0,0 +1,43 @@
+#ifndef Accumulation_h
+#define Accumulation_h
+
+#include "Vec3.h"
+
+#include <istream>
+#include <ostream>
+#include <vector>
+
+class Tracer;
+
+// Samples first to first + count - 1 drawn with seed.
+struct SampleRange {
+	unsigned int seed = 0;
+	int first = 0;
+	int count = 0;
+};
+
+// Raw pixel sums of a partial render and the samples that went into them.
+// Jobs rendering disjoint sample ranges of the same frame add up to the
+// image a single render of all their samples would give.
+struct Accumulation {
+	int width = 0;
+	int height = 0;
+	std::vector<SampleRange> ranges;
+	std::vector<Vec3> sum; // top row first
+
+	int samples() const;
+	// Adds the sums and ranges of other. Throws std::runtime_error if the
+	// sizes differ or a range with the same seed overlaps one already here.
+	void merge(const Accumulation& other);
+};
+
+// The tracer's buffer as one range of its seed.
+Accumulation accumulation(const Tracer& tracer);
+
+// Binary file: a header with the size and ranges followed by the sums as
+// floats, all in host byte order. Reading throws std::runtime_error on
+// malformed or truncated files.
+void writeAccumulation(std::ostream& file, const Accumulation& acc);
+Accumulation readAccumulation(std::istream& file);
+
+#endif
@@ -0,0 +1,142 @@
+#include "Batch.h"
+#include "Sphere.h"
+#include "Quad.h"
+#include "Hit.h"
+#include "Simd.h"
+
+#include <limits>
+
+const float kNoHit = std::numeric_limits<float>::infinity();
+
+int nearestLane(const float* t, float& tmax) {
+	int lane = -1;
+	for (int i = 0; i < kBatchSize; i++) {
+		if (t[i] < kNoHit && t[i] <= tmax) {
+			tmax = t[i];
+			lane = i;
+		}
+	}
+	return lane;
+}
+
+SphereBatch::SphereBatch() {
+	for (int i = 0; i < kBatchSize; i++) {
+		cx[i] = cy[i] = cz[i] = 0;
+		mx[i] = my[i] = mz[i] = 0;
+		r2[i] = -1;
+		index[i] = 0;
+	}
+}
+
+void SphereBatch::set(int lane, const Sphere& sphere, uint32_t sphereIndex) {
+	cx[lane] = sphere.center.x;
+	cy[lane] = sphere.center.y;
+	cz[lane] = sphere.center.z;
+	mx[lane] = sphere.motion.x;
+	my[lane] = sphere.motion.y;
+	mz[lane] = sphere.motion.z;
+	r2[lane] = sphere.radius * sphere.radius;
+	index[lane] = sphereIndex;
+}
+
+int SphereBatch::intersect(const Ray& ray, float tmin, float& tmax) const {
+	const vfloat ox = vset1(ray.origin.x), oy = vset1(ray.origin.y), oz = vset1(ray.origin.z);
+	const vfloat dx = vset1(ray.direction.x), dy = vset1(ray.direction.y), dz = vset1(ray.direction.z);
+	const vfloat zero = vset1(0), vtmin = vset1(tmin), vtmax = vset1(tmax), inf = vset1(kNoHit);
+	const vfloat time = vset1(ray.time);
+	float t[kBatchSize];
+
+	for (int k = 0; k < kBatchSize; k += kSimdWidth) {
+		vfloat ocx = vsub(ox, vadd(vload(cx + k), vmul(vload(mx + k), time)));
+		vfloat ocy = vsub(oy, vadd(vload(cy + k), vmul(vload(my + k), time)));
+		vfloat ocz = vsub(oz, vadd(vload(cz + k), vmul(vload(mz + k), time)));
+
+		// same cancellation-free roots as Sphere::intersect
+		vfloat b = vadd(vadd(vmul(dx, ocx), vmul(dy, ocy)), vmul(dz, ocz));
+		vfloat lx = vsub(ocx, vmul(dx, b));
+		vfloat ly = vsub(ocy, vmul(dy, b));
+		vfloat lz = vsub(ocz, vmul(dz, b));
+		vfloat r = vload(r2 + k);
+		vfloat det = vsub(r, vadd(vadd(vmul(lx, lx), vmul(ly, ly)), vmul(lz, lz)));
+		vfloat mask = vge(det, zero);
+
+		vfloat s = vsqrt(vselect(mask, det, zero));
+		vfloat a = vsub(zero, b);
+		vfloat q = vselect(vlt(zero, b), vsub(a, s), vadd(a, s));
+		vfloat c = vsub(vadd(vadd(vmul(ocx, ocx), vmul(ocy, ocy)), vmul(ocz, ocz)), r);
+		vfloat other = vdiv(c, vselect(mask, q, vset1(1)));
+		vfloat nearT = vselect(vlt(q, other), q, other);
+		vfloat farT = vselect(vlt(q, other), other, q);
+		vfloat dist = vselect(vlt(nearT, zero), farT, nearT);
+
+		mask = vand(mask, vand(vge(dist, vtmin), vle(dist, vtmax)));
+		vstore(t + k, vselect(mask, dist, inf));
+	}
+
+	return nearestLane(t, tmax);
+}
+
+QuadBatch::QuadBatch() {
+	for (int i = 0; i < kBatchSize; i++) {
+		ox[i] = oy[i] = oz[i] = 0;
+		ux[i] = uy[i] = uz[i] = 0;
+		vx[i] = vy[i] = vz[i] = 0;
+		index[i] = 0;
+	}
+}
+
+void QuadBatch::set(int lane, const Quad& quad, uint32_t quadIndex) {
+	ox[lane] = quad.origin.x;
+	oy[lane] = quad.origin.y;
+	oz[lane] = quad.origin.z;
+	ux[lane] = quad.u.x;
+	uy[lane] = quad.u.y;
+	uz[lane] = quad.u.z;
+	vx[lane] = quad.v.x;
+	vy[lane] = quad.v.y;
+	vz[lane] = quad.v.z;
+	index[lane] = quadIndex;
+}
+
+int QuadBatch::intersect(const Ray& ray, float tmin, float& tmax) const {
+	const vfloat rox = vset1(ray.origin.x), roy = vset1(ray.origin.y), roz = vset1(ray.origin.z);
+	const vfloat dx = vset1(ray.direction.x), dy = vset1(ray.direction.y), dz = vset1(ray.direction.z);
+	const vfloat zero = vset1(0), one = vset1(1), eps = vset1(kEpsilon);
+	const vfloat vtmin = vset1(tmin < kEpsilon ? kEpsilon : tmin), vtmax = vset1(tmax), inf = vset1(kNoHit);
+	float t[kBatchSize];
+
+	for (int k = 0; k < kBatchSize; k += kSimdWidth) {
+		vfloat eux = vload(ux + k), euy = vload(uy + k), euz = vload(uz + k);
+		vfloat evx = vload(vx + k), evy = vload(vy + k), evz = vload(vz + k);
+
+		// h = d x v
+		vfloat hx = vsub(vmul(dy, evz), vmul(dz, evy));
+		vfloat hy = vsub(vmul(dz, evx), vmul(dx, evz));
+		vfloat hz = vsub(vmul(dx, evy), vmul(dy, evx));
+
+		vfloat a = vadd(vadd(vmul(eux, hx), vmul(euy, hy)), vmul(euz, hz));
+		vfloat mask = vge(vabs(a), eps);
+		vfloat f = vdiv(one, vselect(mask, a, one));
+
+		vfloat sx = vsub(rox, vload(ox + k));
+		vfloat sy = vsub(roy, vload(oy + k));
+		vfloat sz = vsub(roz, vload(oz + k));
+
+		vfloat u = vmul(f, vadd(vadd(vmul(sx, hx), vmul(sy, hy)), vmul(sz, hz)));
+		mask = vand(mask, vand(vge(u, zero), vle(u, one)));
+
+		// q = s x u
+		vfloat qx = vsub(vmul(sy, euz), vmul(sz, euy));
+		vfloat qy = vsub(vmul(sz, eux), vmul(sx, euz));
+		vfloat qz = vsub(vmul(sx, euy), vmul(sy, eux));
+
+		vfloat v = vmul(f, vadd(vadd(vmul(dx, qx), vmul(dy, qy)), vmul(dz, qz)));
+		mask = vand(mask, vand(vge(v, zero), vle(v, one)));
+
+		vfloat dist = vmul(f, vadd(vadd(vmul(evx, qx), vmul(evy, qy)), vmul(evz, qz)));
+		mask = vand(mask, vand(vge(dist, vtmin), vle(dist, vtmax)));
+		vstore(t + k, vselect(mask, dist, inf));
+	}
+
+	return nearestLane(t, tmax);
+}
@@ -0,0 +1,54 @@
+#ifndef Batch_h
+#define Batch_h
+
+#include "Ray.h"
+
+#include <cstdint>
+
+struct Sphere;
+struct Quad;
+
+// Number of primitives tested together. Padding lanes never hit.
+const int kBatchSize = 8;
+
+// Structure-of-arrays block of spheres, tested 8 at a time in BVH leaves.
+struct SphereBatch {
+	float cx[kBatchSize];
+	float cy[kBatchSize];
+	float cz[kBatchSize];
+	float mx[kBatchSize]; // motion of the centers over the shutter interval
+	float my[kBatchSize];
+	float mz[kBatchSize];
+	float r2[kBatchSize];
+	uint32_t index[kBatchSize];
+	int count = 0;
+
+	SphereBatch();
+	void set(int lane, const Sphere& sphere, uint32_t sphereIndex);
+
+	// Returns the lane of the nearest hit in [tmin, tmax] and shrinks tmax, or -1.
+	int intersect(const Ray& ray, float tmin, float& tmax) const;
+};
+
+// Structure-of-arrays block of quads (origin plus edge vectors u and v).
+struct QuadBatch {
+	float ox[kBatchSize];
+	float oy[kBatchSize];
+	float oz[kBatchSize];
+	float ux[kBatchSize];
+	float uy[kBatchSize];
+	float uz[kBatchSize];
+	float vx[kBatchSize];
+	float vy[kBatchSize];
+	float vz[kBatchSize];
+	uint32_t index[kBatchSize];
+	int count = 0;
+
+	QuadBatch();
+	void set(int lane, const Quad& quad, uint32_t quadIndex);
+
+	// Returns the lane of the nearest hit in [tmin, tmax] and shrinks tmax, or -1.
+	int intersect(const Ray& ray, float tmin, float& tmax) const;
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "Bsdf.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+void basis(const Vec3& n, Vec3& right, Vec3& forward) {
+	right = normalized(cross(n, fabsf(n.y) > 0.99f ? Vec3(0, 0, 1) : Vec3(1, 0, 0)));
+	forward = cross(right, n);
+}
+
+// GGX normal distribution for the cosine between microfacet and surface normal.
+float ggxD(float cosh, float a2) {
+	if (cosh <= 0) return 0;
+	float d = cosh * cosh * (a2 - 1) + 1;
+	return a2 / (M_PI * d * d);
+}
+
+// Smith shadowing-masking of a single direction.
+float ggxG1(float cosv, float a2) {
+	cosv = fabsf(cosv);
+	return 2 * cosv / (cosv + sqrtf(a2 + (1 - a2) * cosv * cosv));
+}
+
+// Microfacet normal distributed by D(h) * cos(h).
+Vec3 sampleGgx(const Vec3& n, float alpha, Prng& prng) {
+	float u1 = prng.frand(0, 1);
+	float u2 = prng.frand(0, 1);
+	float cos2 = (1 - u1) / (1 + (alpha * alpha - 1) * u1);
+	float cost = sqrtf(cos2);
+	float sint = sqrtf(std::max(0.0f, 1 - cos2));
+	float phi = 2 * M_PI * u2;
+
+	Vec3 right, forward;
+	basis(n, right, forward);
+	return right * (cosf(phi) * sint) + forward * (sinf(phi) * sint) + n * cost;
+}
+
+Vec3 schlick(const Vec3& f0, float cosi) {
+	float m = 1 - cosi;
+	float m5 = m * m * m * m * m;
+	return f0 + (Vec3(1, 1, 1) - f0) * m5;
+}
+
+Vec3 diffuseEval(const Vec3& n, const Vec3& color, const Vec3& wi) {
+	return color * (std::max(0.0f, dot(n, wi)) / float(M_PI));
+}
+
+float diffusePdf(const Vec3& n, const Vec3& wi) {
+	return std::max(0.0f, dot(n, wi)) / float(M_PI);
+}
+
+Vec3 conductorEval(const Vec3& n, const Vec3& color, float alpha, const Vec3& wo, const Vec3& wi) {
+	float coso = dot(n, wo);
+	float cosi = dot(n, wi);
+	if (coso <= 0 || cosi <= 0) return Vec3(0, 0, 0);
+	float a2 = alpha * alpha;
+	auto h = normalized(wo + wi);
+	float g = ggxG1(coso, a2) * ggxG1(cosi, a2);
+	return schlick(color, dot(wo, h)) * (ggxD(dot(n, h), a2) * g / (4 * coso));
+}
+
+float conductorPdf(const Vec3& n, float alpha, const Vec3& wo, const Vec3& wi) {
+	if (dot(n, wi) <= 0) return 0;
+	auto h = normalized(wo + wi);
+	float oh = dot(wo, h);
+	if (oh <= 0) return 0;
+	float cosh = dot(n, h);
+	return ggxD(cosh, alpha * alpha) * cosh / (4 * oh);
+}
+
+// The transmitted half vector is wo + eta * wi, flipped to the side of n.
+Vec3 dielectricEval(const Vec3& n, const Vec3& color, float alpha, float eta, const Vec3& wo, const Vec3& wi) {
+	float coso = dot(n, wo);
+	float cosi = dot(n, wi);
+	float a2 = alpha * alpha;
+	float g = ggxG1(coso, a2) * ggxG1(cosi, a2);
+
+	if (cosi > 0) {
+		auto h = normalized(wo + wi);
+		float f = fresnel(-wo, h, 1, eta);
+		return Vec3(1, 1, 1) * (f * ggxD(dot(n, h), a2) * g / (4 * coso));
+	}
+
+	auto h = normalized(wo + wi * eta);
+	if (dot(n, h) < 0) h = -h;
+	float oh = dot(wo, h);
+	float ih = dot(wi, h);
+	if (oh <= 0 || ih >= 0) return Vec3(0, 0, 0);
+	float f = fresnel(-wo, h, 1, eta);
+	float denom = oh + eta * ih;
+	return color * ((1 - f) * ggxD(dot(n, h), a2) * g * oh * -ih * eta * eta / (coso * denom * denom));
+}
+
+float dielectricPdf(const Vec3& n, float alpha, float eta, const Vec3& wo, const Vec3& wi) {
+	float a2 = alpha * alpha;
+
+	if (dot(n, wi) > 0) {
+		auto h = normalized(wo + wi);
+		float oh = dot(wo, h);
+		if (oh <= 0) return 0;
+		float cosh = dot(n, h);
+		return fresnel(-wo, h, 1, eta) * ggxD(cosh, a2) * cosh / (4 * oh);
+	}
+
+	auto h = normalized(wo + wi * eta);
+	if (dot(n, h) < 0) h = -h;
+	float oh = dot(wo, h);
+	float ih = dot(wi, h);
+	if (oh <= 0 || ih >= 0) return 0;
+	float cosh = dot(n, h);
+	float denom = oh + eta * ih;
+	return (1 - fresnel(-wo, h, 1, eta)) * ggxD(cosh, a2) * cosh * -ih * eta * eta / (denom * denom);
+}
+
+}
+
+Bsdf::Bsdf(const MaterialProperties& material, const Vec3& normal, float eta) :
+	normal(normal),
+	color(material.color),
+	alpha(material.roughness),
+	eta(eta)
+{
+	weights[kConductor] = material.metallic;
+	weights[kDiffuse] = (1 - material.metallic) * material.opacity;
+	weights[kDielectric] = (1 - material.metallic) * (1 - material.opacity);
+
+	delta[kDiffuse] = false;
+	delta[kConductor] = alpha < kDeltaRoughness;
+	delta[kDielectric] = alpha < kDeltaRoughness || fabsf(eta - 1) < 1e-4f;
+}
+
+bool Bsdf::isDelta() const {
+	for (int i = 0; i < kNumLobes; i++) {
+		if (weights[i] > 0 && !delta[i]) return false;
+	}
+	return true;
+}
+
+Vec3 Bsdf::eval(const Vec3& wo, const Vec3& wi) const {
+	Vec3 result(0, 0, 0);
+	if (weights[kDiffuse] > 0) result += diffuseEval(normal, color, wi) * weights[kDiffuse];
+	if (weights[kConductor] > 0 && !delta[kConductor]) result += conductorEval(normal, color, alpha, wo, wi) * weights[kConductor];
+	if (weights[kDielectric] > 0 && !delta[kDielectric]) result += dielectricEval(normal, color, alpha, eta, wo, wi) * weights[kDielectric];
+	return result;
+}
+
+float Bsdf::pdf(const Vec3& wo, const Vec3& wi) const {
+	float result = 0;
+	if (weights[kDiffuse] > 0) result += diffusePdf(normal, wi) * weights[kDiffuse];
+	if (weights[kConductor] > 0 && !delta[kConductor]) result += conductorPdf(normal, alpha, wo, wi) * weights[kConductor];
+	if (weights[kDielectric] > 0 && !delta[kDielectric]) result += dielectricPdf(normal, alpha, eta, wo, wi) * weights[kDielectric];
+	return result;
+}
+
+BsdfSample Bsdf::sample(const Vec3& wo, Prng& prng) const {
+	BsdfSample result;
+
+	float u = prng.frand(0, 1);
+	int lobe = kDiffuse;
+	if (u < weights[kConductor]) lobe = kConductor;
+	else if (u >= weights[kConductor] + weights[kDiffuse]) lobe = kDielectric;
+
+	if (lobe == kDiffuse) {
+		result.direction = prng.randomPointOnUnitHemisphereCosine(normal);
+	}
+	else {
+		bool delta = this->delta[lobe];
+		auto h = alpha < kDeltaRoughness ? normal : sampleGgx(normal, alpha, prng);
+		float oh = dot(wo, h);
+		if (oh <= 0) return result;
+
+		// microfacets can send the ray to the wrong side of the surface, where
+		// the pdf of the lobe is 0, so those samples are dropped
+		if (lobe == kConductor) {
+			result.direction = h * (2 * oh) - wo;
+			if (dot(result.direction, normal) <= 0) return BsdfSample();
+			if (delta) {
+				result.weight = schlick(color, oh);
+				return result;
+			}
+		}
+		else {
+			bool reflected = prng.frand(0, 1) < fresnel(-wo, h, 1, eta);
+			result.direction = reflected ? h * (2 * oh) - wo : refract(-wo, h, 1, eta);
+			if ((dot(result.direction, normal) > 0) != reflected) return BsdfSample();
+			if (delta) {
+				result.weight = reflected ? Vec3(1, 1, 1) : color;
+				return result;
+			}
+		}
+	}
+
+	// the density and value of the whole mixture, as other lobes can produce the same direction
+	result.pdf = pdf(wo, result.direction);
+	if (result.pdf <= 0) return BsdfSample();
+	result.weight = eval(wo, result.direction) / result.pdf;
+	return result;
+}
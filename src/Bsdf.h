@@ -0,0 +1,47 @@
+#ifndef Bsdf_h
+#define Bsdf_h
+
+#include "Vec3.h"
+#include "Prng.h"
+#include "Material.h"
+
+// GGX lobes smoother than this are sampled as perfect mirrors and refractions.
+const float kDeltaRoughness = 0.001f;
+
+enum BsdfLobe {
+	kDiffuse,
+	kConductor,  // GGX reflection tinted by a Schlick fresnel
+	kDielectric, // GGX reflection and refraction weighted by the dielectric fresnel
+	kNumLobes
+};
+
+struct BsdfSample {
+	Vec3 direction;
+	Vec3 weight = Vec3(0, 0, 0); // bsdf * cos / pdf, the factor applied to the path throughput
+	float pdf = 0; // solid angle density, 0 for a mirror or refraction
+};
+
+// Mixture of the lobes at a surface point. Directions point away from the
+// surface and the normal faces wo. eval returns bsdf * cos and pdf the density
+// of sample producing wi, both leave out the delta lobes that only sampling
+// can reach: GGX lobes smoother than kDeltaRoughness, and refraction between
+// equal iors, which passes straight through.
+struct Bsdf {
+	// eta is the ior on the far side of the surface over the ior on the near side.
+	Bsdf(const MaterialProperties& material, const Vec3& normal, float eta);
+
+	Vec3 eval(const Vec3& wo, const Vec3& wi) const;
+	float pdf(const Vec3& wo, const Vec3& wi) const;
+	BsdfSample sample(const Vec3& wo, Prng& prng) const;
+	// True if only delta lobes are present, so light sampling cannot contribute.
+	bool isDelta() const;
+
+	Vec3 normal;
+	Vec3 color;
+	float alpha; // GGX roughness
+	float eta;
+	float weights[kNumLobes]; // probability of each lobe, summing to 1
+	bool delta[kNumLobes];
+};
+
+#endif
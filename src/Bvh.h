@@ -0,0 +1,236 @@
+#ifndef Bvh_h
+#define Bvh_h
+
+#include "AABB.h"
+#include "Ray.h"
+#include "Batch.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+struct BvhNode {
+	AABB bounds;
+	uint32_t first; // first of the two adjacent children, or the batch index of a leaf
+	uint32_t count; // number of primitives in the leaf batch, 0 for inner nodes
+};
+
+// Returns the entry distance of the ray into the box, or -1 if it misses [tmin, tmax].
+inline float intersectBounds(const AABB& b, const Vec3& origin, const Vec3& invDir, float tmin, float tmax) {
+	float tx1 = (b.min.x - origin.x) * invDir.x;
+	float tx2 = (b.max.x - origin.x) * invDir.x;
+	float ty1 = (b.min.y - origin.y) * invDir.y;
+	float ty2 = (b.max.y - origin.y) * invDir.y;
+	float tz1 = (b.min.z - origin.z) * invDir.z;
+	float tz2 = (b.max.z - origin.z) * invDir.z;
+
+	float t0 = std::max(tmin, std::max(std::min(tx1, tx2), std::max(std::min(ty1, ty2), std::min(tz1, tz2))));
+	float t1 = std::min(tmax, std::min(std::max(tx1, tx2), std::min(std::max(ty1, ty2), std::max(tz1, tz2))));
+	return t0 <= t1 ? t0 : -1;
+}
+
+// Leaf batch that only records primitive indices, for primitives that are
+// intersected one by one (e.g. mesh instances).
+struct IndexBatch {
+	uint32_t index[kBatchSize];
+	int count = 0;
+
+	template<typename Prim>
+	void set(int lane, const Prim& prim, uint32_t primIndex) {
+		index[lane] = primIndex;
+	}
+};
+
+// A refitted BVH is rebuilt once its SAH cost exceeds this multiple of the
+// cost it had when it was built.
+const float kMaxRefitCost = 1.5f;
+
+// Bounding volume hierarchy whose leaves are SIMD batches of up to
+// kBatchSize primitives of a single type.
+template<typename Batch>
+class BatchBvh {
+public:
+	template<typename Prim>
+	void build(const std::vector<Prim>& prims) {
+		nodes.clear();
+		batches.clear();
+		primCount = prims.size();
+		builtCost = 0;
+		if (prims.empty()) return;
+
+		std::vector<AABB> bounds;
+		std::vector<Vec3> centers;
+		std::vector<uint32_t> indices;
+		bounds.reserve(prims.size());
+		centers.reserve(prims.size());
+		indices.reserve(prims.size());
+		for (size_t i = 0; i < prims.size(); i++) {
+			bounds.push_back(prims[i].getBounds());
+			centers.push_back(bounds.back().center());
+			indices.push_back(i);
+		}
+
+		nodes.push_back(BvhNode());
+		buildNode(0, prims, bounds, centers, indices.data(), indices.size());
+		builtCost = cost();
+	}
+
+	// Fits the node bounds around prims again after they moved, keeping the
+	// tree and leaf assignment. prims must be the primitives the tree was
+	// built over, in the same order. Returns the SAH cost of the refitted
+	// tree relative to its cost when built; it grows as primitives that were
+	// grouped together drift apart.
+	template<typename Prim>
+	float refit(const std::vector<Prim>& prims) {
+		// children are always stored after their parent
+		for (size_t n = nodes.size(); n-- > 0;) {
+			auto& node = nodes[n];
+			AABB bounds;
+			if (node.count > 0) {
+				auto& batch = batches[node.first];
+				for (uint32_t i = 0; i < node.count; i++) {
+					uint32_t index = batch.index[i];
+					batch.set(i, prims[index], index);
+					bounds.enclose(prims[index].getBounds());
+				}
+			}
+			else {
+				bounds = nodes[node.first].bounds;
+				bounds.enclose(nodes[node.first + 1].bounds);
+			}
+			node.bounds = bounds;
+		}
+		return builtCost > 0 ? cost() / builtCost : 1;
+	}
+
+	// Refits after primitives moved, or rebuilds when refitting has degraded
+	// the tree too far or primitives were added or removed. Returns true if
+	// the tree was rebuilt.
+	template<typename Prim>
+	bool update(const std::vector<Prim>& prims) {
+		if (prims.size() == primCount && refit(prims) <= kMaxRefitCost) return false;
+		build(prims);
+		return true;
+	}
+
+	// Expected cost of a random ray through the tree: surface areas of the
+	// nodes relative to the root, leaves weighted by their primitive count.
+	float cost() const {
+		if (nodes.empty()) return 0;
+		float rootArea = nodes[0].bounds.surfaceArea();
+		if (rootArea <= 0) return 0;
+		float sum = 0;
+		for (auto& node : nodes) {
+			sum += node.bounds.surfaceArea() * (node.count > 0 ? node.count : 1);
+		}
+		return sum / rootArea;
+	}
+
+	// Returns the index of the nearest primitive hit in [tmin, tmax] and
+	// shrinks tmax to its distance, or -1. With anyHit the first hit found is returned.
+	int intersect(const Ray& ray, float tmin, float& tmax, bool anyHit = false) const {
+		int result = -1;
+		traverse(ray, tmin, tmax, anyHit, [&](const Batch& batch, float& limit) {
+			int lane = batch.intersect(ray, tmin, limit);
+			if (lane < 0) return false;
+			result = batch.index[lane];
+			return true;
+		});
+		return result;
+	}
+
+	// Calls leaf(batch, tmax) for every leaf the ray enters, nearest first.
+	// The callback shrinks tmax and returns true when it found a hit.
+	template<typename F>
+	bool traverse(const Ray& ray, float tmin, float& tmax, bool anyHit, F&& leaf) const {
+		if (nodes.empty()) return false;
+
+		const Vec3 invDir(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+		uint32_t stack[64];
+		int top = 0;
+		bool found = false;
+
+		if (intersectBounds(nodes[0].bounds, ray.origin, invDir, tmin, tmax) < 0) return false;
+		stack[top++] = 0;
+
+		while (top > 0) {
+			auto& node = nodes[stack[--top]];
+
+			if (node.count > 0) {
+				if (leaf(batches[node.first], tmax)) {
+					found = true;
+					if (anyHit) break;
+				}
+				continue;
+			}
+
+			float tl = intersectBounds(nodes[node.first].bounds, ray.origin, invDir, tmin, tmax);
+			float tr = intersectBounds(nodes[node.first + 1].bounds, ray.origin, invDir, tmin, tmax);
+			if (tl >= 0 && tr >= 0) {
+				// visit the nearer child first
+				if (tl <= tr) {
+					stack[top++] = node.first + 1;
+					stack[top++] = node.first;
+				}
+				else {
+					stack[top++] = node.first;
+					stack[top++] = node.first + 1;
+				}
+			}
+			else if (tl >= 0) stack[top++] = node.first;
+			else if (tr >= 0) stack[top++] = node.first + 1;
+		}
+
+		return found;
+	}
+
+public:
+	std::vector<BvhNode> nodes;
+	std::vector<Batch> batches;
+
+private:
+	size_t primCount = 0;
+	float builtCost = 0;
+
+	template<typename Prim>
+	void buildNode(uint32_t nodeIndex, const std::vector<Prim>& prims, const std::vector<AABB>& bounds, const std::vector<Vec3>& centers, uint32_t* indices, size_t count) {
+		AABB nodeBounds;
+		AABB centerBounds;
+		for (size_t i = 0; i < count; i++) {
+			nodeBounds.enclose(bounds[indices[i]]);
+			centerBounds.enclose(centers[indices[i]]);
+		}
+		nodes[nodeIndex].bounds = nodeBounds;
+
+		if (count <= kBatchSize) {
+			Batch batch;
+			for (size_t i = 0; i < count; i++) {
+				batch.set(i, prims[indices[i]], indices[i]);
+			}
+			batch.count = count;
+			nodes[nodeIndex].first = batches.size();
+			nodes[nodeIndex].count = count;
+			batches.push_back(batch);
+			return;
+		}
+
+		// median split along the longest axis of the primitive centers
+		auto extent = centerBounds.max - centerBounds.min;
+		int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+		size_t mid = count / 2;
+		std::nth_element(indices, indices + mid, indices + count, [&](uint32_t a, uint32_t b) {
+			return (&centers[a].x)[axis] < (&centers[b].x)[axis];
+		});
+
+		uint32_t left = nodes.size();
+		nodes.push_back(BvhNode());
+		nodes.push_back(BvhNode());
+		nodes[nodeIndex].first = left;
+		nodes[nodeIndex].count = 0;
+
+		buildNode(left, prims, bounds, centers, indices, mid);
+		buildNode(left + 1, prims, bounds, centers, indices + mid, count - mid);
+	}
+};
+
+#endif
@@ -0,0 +1,145 @@
+#include "Checkpoint.h"
+#include "Tracer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Forces the file's data onto the disk, so a rename after it cannot reach
+// the disk first and leave a truncated checkpoint after a power loss.
+void syncFile(const std::string& filename) {
+#ifdef _WIN32
+	int fd = _open(filename.c_str(), _O_WRONLY | _O_BINARY);
+	bool synced = fd >= 0 && _commit(fd) == 0;
+	if (fd >= 0) _close(fd);
+#else
+	int fd = ::open(filename.c_str(), O_WRONLY);
+	bool synced = fd >= 0 && fsync(fd) == 0;
+	if (fd >= 0) ::close(fd);
+#endif
+	if (!synced) throw std::runtime_error(filename + ": cannot sync to disk");
+}
+
+// Makes the rename itself durable. Best effort, not every file system
+// allows syncing a directory.
+void syncDirectory(const std::string& filename) {
+#ifndef _WIN32
+	auto slash = filename.find_last_of('/');
+	auto directory = slash == std::string::npos ? std::string(".") : filename.substr(0, slash + 1);
+	int fd = ::open(directory.c_str(), O_RDONLY);
+	if (fd < 0) return;
+	fsync(fd);
+	::close(fd);
+#endif
+}
+
+void writeFile(const std::string& filename, const Accumulation& acc) {
+	auto temporary = filename + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary);
+		if (!file) throw std::runtime_error(temporary + ": cannot open for writing");
+		writeAccumulation(file, acc);
+		file.close();
+		if (!file) throw std::runtime_error(temporary + ": write failed");
+	}
+	syncFile(temporary);
+#ifdef _WIN32
+	// rename does not replace existing files here
+	std::remove(filename.c_str());
+#endif
+	if (std::rename(temporary.c_str(), filename.c_str()) != 0) throw std::runtime_error(filename + ": cannot replace");
+	syncDirectory(filename);
+}
+
+}
+
+Checkpointer::Checkpointer(const std::string& filename): filename(filename) {
+	writer = std::thread(&Checkpointer::run, this);
+}
+
+Checkpointer::~Checkpointer() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	changed.notify_all();
+	writer.join();
+}
+
+void Checkpointer::save(const Tracer& tracer) {
+	auto snapshot = accumulation(tracer);
+	std::lock_guard<std::mutex> guard(lock);
+	if (!error.empty()) throw std::runtime_error(error);
+	pending = std::move(snapshot);
+	hasPending = true;
+	changed.notify_all();
+}
+
+void Checkpointer::flush() {
+	std::unique_lock<std::mutex> guard(lock);
+	changed.wait(guard, [&] { return !hasPending && !writing; });
+	if (!error.empty()) throw std::runtime_error(error);
+}
+
+void Checkpointer::run() {
+	std::unique_lock<std::mutex> guard(lock);
+	for (;;) {
+		changed.wait(guard, [&] { return hasPending || stopping; });
+		if (!hasPending) break;
+
+		auto snapshot = std::move(pending);
+		hasPending = false;
+		writing = true;
+		guard.unlock();
+		std::string failure;
+		try {
+			writeFile(filename, snapshot);
+		}
+		catch (const std::exception& e) {
+			failure = e.what();
+		}
+		guard.lock();
+		writing = false;
+		if (!failure.empty()) error = failure;
+		changed.notify_all();
+	}
+}
+
+bool resume(Tracer& tracer, const std::string& filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) return false;
+
+	Accumulation acc;
+	try {
+		acc = readAccumulation(file);
+	}
+	catch (const std::exception& e) {
+		throw std::runtime_error(filename + ": " + e.what());
+	}
+	if (acc.width != tracer.width || acc.height != tracer.height) {
+		throw std::runtime_error(filename + ": checkpoint of a " + std::to_string(acc.width) + "x" + std::to_string(acc.height) + " image");
+	}
+	if (acc.ranges.size() > 1) throw std::runtime_error(filename + ": merged jobs cannot be resumed");
+
+	tracer.clear();
+	if (acc.ranges.empty()) return true;
+	auto& range = acc.ranges[0];
+	if (range.seed != tracer.randomSeed || range.first != tracer.firstSample) {
+		throw std::runtime_error(filename + ": checkpoint of seed " + std::to_string(range.seed)
+			+ " from sample " + std::to_string(range.first));
+	}
+	std::copy(acc.sum.begin(), acc.sum.end(), tracer.buffer);
+	tracer.numSamples = range.count;
+	return true;
+}
@@ -0,0 +1,54 @@
+#ifndef Checkpoint_h
+#define Checkpoint_h
+
+#include "Accumulation.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class Tracer;
+
+// Writes snapshots of a render as accumulation files on a background
+// thread, so sampling only waits for a copy of the buffer. Each snapshot
+// goes to a temporary file that is synced to disk and then replaces the
+// checkpoint, a crash or power loss mid-write leaves the previous one intact. Since every sample draws from
+// its own seeded stream, the sums, the seed and the sample range are all
+// the sampler state there is.
+class Checkpointer {
+public:
+	explicit Checkpointer(const std::string& filename);
+	// Writes the last snapshot if it is still pending.
+	~Checkpointer();
+	Checkpointer(const Checkpointer&) = delete;
+	Checkpointer& operator=(const Checkpointer&) = delete;
+
+	// Copies the tracer's buffer and returns; a snapshot still waiting to be
+	// written is replaced. Throws std::runtime_error if an earlier write failed.
+	void save(const Tracer& tracer);
+	// Waits until the last snapshot is on disk. Throws std::runtime_error if
+	// a write failed.
+	void flush();
+
+private:
+	void run();
+
+	std::string filename;
+	std::mutex lock;
+	std::condition_variable changed;
+	Accumulation pending;
+	bool hasPending = false;
+	bool writing = false;
+	bool stopping = false;
+	std::string error;
+	std::thread writer;
+};
+
+// Loads a checkpoint into the tracer's buffer and sample count, so the next
+// sample continues where the checkpointed render stopped. Returns false if
+// the file does not exist. Throws std::runtime_error if it is malformed, of
+// another image size, or of another seed or first sample than the tracer.
+bool resume(Tracer& tracer, const std::string& filename);
+
+#endif
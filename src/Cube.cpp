@@ -4,6 +4,7 @@
 
 #include <cmath>
 #include <array>
+#include <algorithm>
 
 bool Cube::intersect(const Ray& ray, Hit* hit) {
 
@@ -57,17 +58,55 @@ bool Cube::intersect(const Ray& ray, Hit* hit) {
 		if (tmin > hit->distance || tmin < hit->minDistance) return false;
 		hit->distance = tmin;
 		hit->material = material;
-		hit->obj = this;
 		hit->normal = boxnormal((ray.origin + ray.direction * tmin - center) / size);
 	}
 
 	return true;
 }
 
+bool Cube::occluded(const Ray& ray, float tMax) const {
+	auto origin = ray.origin - center;
+	auto hsize = size / 2;
+	float t0 = -INFINITY;
+	float t1 = INFINITY;
+	for (int axis = 0; axis < 3; axis++) {
+		float o = (&origin.x)[axis];
+		float d = (&ray.direction.x)[axis];
+		float h = (&hsize.x)[axis];
+		float ta = (-h - o) / d;
+		float tb = (h - o) / d;
+		t0 = std::max(t0, std::min(ta, tb));
+		t1 = std::min(t1, std::max(ta, tb));
+	}
+	if (t0 > t1) return false;
+
+	// either face the ray crosses blocks it
+	return (t0 > kMinDistance && t0 < tMax) || (t1 > kMinDistance && t1 < tMax);
+}
+
 float Cube::getSurfaceArea() {
 	return 2 * size.x*size.y + 2 * size.x*size.z + 2 * size.y*size.z;
 }
 
-Vec3 Cube::getRandomPoint(Prng& prng) {
-	return center + prng.randomPointInUnitCube() * size;
-}
\ No newline at end of file
+SurfaceSample Cube::sampleSurface(Prng& prng, float time) {
+	// pick a pair of opposing faces by area, then one of the two
+	float yz = size.y * size.z;
+	float xz = size.x * size.z;
+	float xy = size.x * size.y;
+	float r = prng.frand(0, yz + xz + xy);
+	int axis = r < yz ? 0 : (r < yz + xz ? 1 : 2);
+	float side = prng.frand(0, 1) < 0.5f ? -1.0f : 1.0f;
+
+	auto p = prng.randomPointInUnitCube() * 0.5f;
+	Vec3 n(0, 0, 0);
+	(&p.x)[axis] = side * 0.5f;
+	(&n.x)[axis] = side;
+	return { center + p * size, n, Vec3(0, 0, 0) };
+}
+
+AABB Cube::getBounds() const {
+	AABB bounds;
+	bounds.enclose(center - size / 2);
+	bounds.enclose(center + size / 2);
+	return bounds;
+}
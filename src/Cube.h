@@ -4,16 +4,19 @@
 #include "Vec3.h"
 #include "Material.h"
 #include "Object.h"
+#include "AABB.h"
 
 struct Cube: Object {
 	Vec3 center;
 	Vec3 size;
 
-	Cube(const Vec3& center, const Vec3& size, Material* material) : center(center), size(size) { this->material = material; }
+	Cube(const Vec3& center, const Vec3& size, MaterialId material) : center(center), size(size) { this->material = material; }
 
-	float getSurfaceArea() final override;
-	bool intersect(const Ray& ray, Hit* hit) final override;
-	Vec3 getRandomPoint(Prng& prng) final override;
+	float getSurfaceArea();
+	bool intersect(const Ray& ray, Hit* hit);
+	bool occluded(const Ray& ray, float tMax) const;
+	SurfaceSample sampleSurface(Prng& prng, float time = 0);
+	AABB getBounds() const;
 };
 
 #endif
\ No newline at end of file
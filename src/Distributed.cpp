@@ -0,0 +1,269 @@
+#include "Distributed.h"
+#include "Socket.h"
+#include "Tracer.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const uint32_t kMagic = 0x57594152; // "RAYW"
+const uint32_t kVersion = 1;
+
+// Sent by a worker after connecting. The object counts let the coordinator
+// turn away workers that built a different scene.
+struct Hello {
+	uint32_t magic = kMagic;
+	uint32_t version = kVersion;
+	uint32_t objects[6] = {};
+};
+
+// Everything about the frame except the scene, sent once per worker.
+struct Job {
+	uint32_t magic = kMagic;
+	int32_t width = 0;
+	int32_t height = 0;
+	float position[3] = {};
+	float yaw = 0;
+	float pitch = 0;
+	float horizontalFov = 0;
+	float focalLength = 0;
+	float apertureSize = 0;
+	int32_t maxDepth = 0;
+	int32_t minDepth = 0;
+	int32_t roulette = 0;
+	uint32_t seed = 0;
+};
+
+// One task, echoed in front of the pixels of the reply. No samples ends the job.
+struct TileMessage {
+	int32_t x = 0;
+	int32_t y = 0;
+	int32_t width = 0;
+	int32_t height = 0;
+	int32_t firstSample = 0;
+	int32_t samples = 0;
+};
+
+Hello hello(Tracer& tracer) {
+	auto& scene = tracer.scene;
+	Hello h;
+	h.objects[0] = scene.spheres.size();
+	h.objects[1] = scene.quads.size();
+	h.objects[2] = scene.cubes.size();
+	h.objects[3] = scene.planes.size();
+	h.objects[4] = scene.instances.size();
+	h.objects[5] = scene.lights.size();
+	return h;
+}
+
+bool operator==(const Hello& a, const Hello& b) {
+	return a.magic == b.magic && a.version == b.version && std::equal(a.objects, a.objects + 6, b.objects);
+}
+
+TileMessage toMessage(const Tile& tile) {
+	return { tile.x, tile.y, tile.width, tile.height, tile.firstSample, tile.samples };
+}
+
+Tile toTile(const TileMessage& m) {
+	Tile tile;
+	tile.x = m.x;
+	tile.y = m.y;
+	tile.width = m.width;
+	tile.height = m.height;
+	tile.firstSample = m.firstSample;
+	tile.samples = m.samples;
+	return tile;
+}
+
+void sendPixels(Socket& socket, const std::vector<Vec3>& pixels) {
+	std::vector<float> floats;
+	floats.reserve(pixels.size() * 3);
+	for (auto& p : pixels) {
+		floats.push_back(p.x);
+		floats.push_back(p.y);
+		floats.push_back(p.z);
+	}
+	socket.send(floats.data(), floats.size() * sizeof(float));
+}
+
+void receivePixels(Socket& socket, std::vector<Vec3>& pixels) {
+	std::vector<float> floats(pixels.size() * 3);
+	socket.receive(floats.data(), floats.size() * sizeof(float));
+	for (size_t i = 0; i < pixels.size(); i++) {
+		pixels[i] = Vec3(floats[i * 3], floats[i * 3 + 1], floats[i * 3 + 2]);
+	}
+}
+
+}
+
+void coordinate(Tracer& tracer, const DistributedSettings& settings) {
+	tracer.prepare();
+	auto expected = hello(tracer);
+
+	Job job;
+	job.width = tracer.width;
+	job.height = tracer.height;
+	job.position[0] = tracer.camera.position.x;
+	job.position[1] = tracer.camera.position.y;
+	job.position[2] = tracer.camera.position.z;
+	job.yaw = tracer.camera.yaw;
+	job.pitch = tracer.camera.pitch;
+	job.horizontalFov = tracer.camera.horizontalFov;
+	job.focalLength = tracer.camera.focalLength;
+	job.apertureSize = tracer.camera.apertureSize;
+	job.maxDepth = tracer.settings.maxDepth;
+	job.minDepth = tracer.settings.minDepth;
+	job.roulette = int32_t(tracer.settings.roulette);
+	job.seed = tracer.randomSeed;
+
+	std::vector<Tile> tiles;
+	int size = std::max(settings.tileSize, 1);
+	int step = settings.tileSamples > 0 ? settings.tileSamples : settings.spp;
+	for (int first = 0; first < settings.spp; first += step) {
+		for (int y = 0; y < tracer.height; y += size) {
+			for (int x = 0; x < tracer.width; x += size) {
+				Tile tile;
+				tile.x = x;
+				tile.y = y;
+				tile.width = std::min(size, tracer.width - x);
+				tile.height = std::min(size, tracer.height - y);
+				tile.firstSample = first;
+				tile.samples = std::min(step, settings.spp - first);
+				tiles.push_back(tile);
+			}
+		}
+	}
+
+	auto listener = Socket::listen(settings.port);
+	std::vector<Socket> workers;
+	while ((int)workers.size() < settings.workers) {
+		auto socket = listener.accept();
+		try {
+			Hello h;
+			socket.receive(&h, sizeof(h));
+			if (!(h == expected)) {
+				fprintf(stderr, "worker turned away: different scene or version\n");
+				continue;
+			}
+			socket.send(&job, sizeof(job));
+		}
+		catch (const std::exception& e) {
+			fprintf(stderr, "worker lost: %s\n", e.what());
+			continue;
+		}
+		workers.push_back(std::move(socket));
+	}
+	listener.close();
+
+	tracer.clear();
+	std::mutex lock;
+	std::condition_variable changed;
+	std::deque<size_t> pending;
+	for (size_t i = 0; i < tiles.size(); i++) pending.push_back(i);
+	size_t finished = 0;
+
+	auto serve = [&](Socket& socket) {
+		std::vector<Vec3> pixels;
+		for (;;) {
+			size_t index;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				// a tile in flight elsewhere may still come back if its worker drops out
+				changed.wait(guard, [&] { return !pending.empty() || finished == tiles.size(); });
+				if (pending.empty()) break;
+				index = pending.front();
+				pending.pop_front();
+			}
+
+			auto& tile = tiles[index];
+			pixels.resize(tile.width * tile.height);
+			try {
+				auto message = toMessage(tile);
+				socket.send(&message, sizeof(message));
+				socket.receive(&message, sizeof(message));
+				receivePixels(socket, pixels);
+			}
+			catch (const std::exception& e) {
+				fprintf(stderr, "worker lost: %s\n", e.what());
+				std::lock_guard<std::mutex> guard(lock);
+				pending.push_back(index);
+				changed.notify_all();
+				return;
+			}
+
+			std::lock_guard<std::mutex> guard(lock);
+			for (int y = 0; y < tile.height; y++) {
+				for (int x = 0; x < tile.width; x++) {
+					tracer.buffer[(tile.y + y) * tracer.width + tile.x + x] += pixels[y * tile.width + x];
+				}
+			}
+			finished++;
+			changed.notify_all();
+		}
+
+		TileMessage done;
+		try {
+			socket.send(&done, sizeof(done));
+		}
+		catch (const std::exception&) {
+			// finished anyway
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (auto& socket : workers) threads.emplace_back(serve, std::ref(socket));
+	for (auto& thread : threads) thread.join();
+
+	if (finished < tiles.size()) throw std::runtime_error("all workers lost before the frame was complete");
+	tracer.numSamples = settings.spp;
+}
+
+void work(Tracer& tracer, const std::string& host, uint16_t port) {
+	auto socket = Socket::connect(host, port);
+	auto h = hello(tracer);
+	socket.send(&h, sizeof(h));
+
+	Job job;
+	socket.receive(&job, sizeof(job));
+	if (job.magic != kMagic) throw std::runtime_error("not a coordinator");
+	if (job.width <= 0 || job.height <= 0) throw std::runtime_error("job with an empty frame");
+	if (job.maxDepth < 1 || job.minDepth < 0 || job.minDepth > job.maxDepth) throw std::runtime_error("job with invalid path depths");
+	if (job.roulette < int32_t(RouletteStrategy::Throughput) || job.roulette > int32_t(RouletteStrategy::Efficiency)) {
+		throw std::runtime_error("job with an unknown roulette strategy");
+	}
+
+	if (job.width != tracer.width || job.height != tracer.height) tracer.resize(job.width, job.height);
+	tracer.camera.position = Vec3(job.position[0], job.position[1], job.position[2]);
+	tracer.camera.yaw = job.yaw;
+	tracer.camera.pitch = job.pitch;
+	tracer.camera.horizontalFov = job.horizontalFov;
+	tracer.camera.focalLength = job.focalLength;
+	tracer.camera.apertureSize = job.apertureSize;
+	tracer.settings.maxDepth = job.maxDepth;
+	tracer.settings.minDepth = job.minDepth;
+	tracer.settings.roulette = RouletteStrategy(job.roulette);
+	tracer.seed(job.seed);
+
+	std::vector<Vec3> pixels;
+	for (;;) {
+		TileMessage message;
+		socket.receive(&message, sizeof(message));
+		if (message.samples <= 0) break;
+		if (message.width <= 0 || message.height <= 0 || message.x < 0 || message.y < 0
+			|| message.x + message.width > job.width || message.y + message.height > job.height) {
+			throw std::runtime_error("tile outside the frame");
+		}
+
+		pixels.resize(message.width * message.height);
+		tracer.renderTile(toTile(message), pixels.data());
+		socket.send(&message, sizeof(message));
+		sendPixels(socket, pixels);
+	}
+}
@@ -0,0 +1,34 @@
+#ifndef Distributed_h
+#define Distributed_h
+
+#include <cstdint>
+#include <string>
+
+class Tracer;
+
+// A frame rendered by several processes. The coordinator splits the image
+// into tiles and sample ranges and hands them out over TCP to the workers
+// that connected to it. Each worker renders its tiles with its own copy of
+// the scene and sends back the summed float pixels, which the coordinator
+// adds into its buffer. Tiles of a worker that drops out go to the others.
+//
+// Messages are plain structs in host byte order, so all processes must run
+// on the same architecture and build the same scene.
+struct DistributedSettings {
+	uint16_t port = 7878;
+	int workers = 1; // connections to wait for before rendering
+	int spp = 16;
+	int tileSize = 32;
+	int tileSamples = 0; // samples per pixel in one task, 0 for all of spp
+};
+
+// Renders the tracer's camera view on the workers into tracer.buffer, with
+// the tracer's seed, and sets numSamples to settings.spp. Throws
+// std::runtime_error if every worker is lost before the frame is complete.
+void coordinate(Tracer& tracer, const DistributedSettings& settings);
+
+// Connects to a coordinator and renders the tiles it sends until the frame
+// is done. Throws std::runtime_error on connection or protocol errors.
+void work(Tracer& tracer, const std::string& host, uint16_t port);
+
+#endif
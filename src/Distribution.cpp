@@ -0,0 +1,105 @@
+#include "Distribution.h"
+
+#include <algorithm>
+
+Distribution1D::Distribution1D(const float* f, int n): func(f, f + n), cdf(n + 1) {
+	cdf[0] = 0;
+	for (int i = 1; i <= n; i++) {
+		cdf[i] = cdf[i - 1] + func[i - 1] / n;
+	}
+	integral = cdf[n];
+
+	if (integral == 0) {
+		for (int i = 1; i <= n; i++) cdf[i] = float(i) / n;
+	}
+	else {
+		for (int i = 1; i <= n; i++) cdf[i] /= integral;
+	}
+}
+
+float Distribution1D::sample(float u, float& pdf, int* offset) const {
+	int n = count();
+	int i = std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin() - 1;
+	i = std::max(0, std::min(n - 1, i));
+	if (offset) *offset = i;
+
+	pdf = integral > 0 ? func[i] / integral : 1;
+
+	float du = u - cdf[i];
+	float width = cdf[i + 1] - cdf[i];
+	if (width > 0) du /= width;
+
+	return std::min((i + du) / n, 0.99999994f);
+}
+
+float Distribution1D::pdf(float x) const {
+	int n = count();
+	int i = std::max(0, std::min(n - 1, int(x * n)));
+	return integral > 0 ? func[i] / integral : 1;
+}
+
+Distribution2D::Distribution2D(const float* f, int nu, int nv) {
+	std::vector<float> rowIntegrals;
+	conditional.reserve(nv);
+	rowIntegrals.reserve(nv);
+	for (int v = 0; v < nv; v++) {
+		conditional.push_back(Distribution1D(f + v * nu, nu));
+		rowIntegrals.push_back(conditional.back().integral);
+	}
+	marginal = Distribution1D(rowIntegrals.data(), nv);
+}
+
+void Distribution2D::sample(float u0, float u1, float& u, float& v, float& pdf) const {
+	float pdfs[2];
+	int row;
+	v = marginal.sample(u1, pdfs[1], &row);
+	u = conditional[row].sample(u0, pdfs[0]);
+	pdf = pdfs[0] * pdfs[1];
+}
+
+float Distribution2D::pdf(float u, float v) const {
+	int nv = marginal.count();
+	int row = std::max(0, std::min(nv - 1, int(v * nv)));
+	return conditional[row].pdf(u) * marginal.pdf(v);
+}
+
+AliasTable::AliasTable(const float* weights, int n): bins(n), pmfs(n) {
+	double sum = 0;
+	for (int i = 0; i < n; i++) sum += weights[i];
+	for (int i = 0; i < n; i++) pmfs[i] = sum > 0 ? float(weights[i] / sum) : 1.0f / n;
+
+	// split bins into those below and above the average and pair them up
+	std::vector<uint32_t> small;
+	std::vector<uint32_t> large;
+	std::vector<float> scaled(n);
+	for (int i = 0; i < n; i++) {
+		scaled[i] = pmfs[i] * n;
+		(scaled[i] < 1 ? small : large).push_back(i);
+	}
+
+	while (!small.empty() && !large.empty()) {
+		auto s = small.back();
+		auto l = large.back();
+		small.pop_back();
+		bins[s].q = scaled[s];
+		bins[s].alias = l;
+		scaled[l] -= 1 - scaled[s];
+		if (scaled[l] < 1) {
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+
+	// whatever is left is 1 up to rounding
+	for (auto i : small) bins[i] = { 1, i };
+	for (auto i : large) bins[i] = { 1, i };
+}
+
+int AliasTable::sample(float u, float& pmf) const {
+	int n = count();
+	float x = u * n;
+	int i = std::min(int(x), n - 1);
+	if (x - i >= bins[i].q) i = bins[i].alias;
+	pmf = pmfs[i];
+	return i;
+}
@@ -0,0 +1,57 @@
+#ifndef Distribution_h
+#define Distribution_h
+
+#include <cstdint>
+#include <vector>
+
+// Piecewise constant 1D distribution over [0, 1) built from n function values.
+struct Distribution1D {
+	std::vector<float> func;
+	std::vector<float> cdf;
+	float integral = 0;
+
+	Distribution1D() = default;
+	Distribution1D(const float* f, int n);
+
+	int count() const { return func.size(); }
+
+	// Maps a uniform u in [0, 1) to a sample in [0, 1), returns the density there.
+	float sample(float u, float& pdf, int* offset = nullptr) const;
+	float pdf(float x) const;
+};
+
+// Piecewise constant 2D distribution over [0, 1)^2 from a row-major nu x nv grid,
+// sampled as a marginal over rows followed by the conditional within the row.
+struct Distribution2D {
+	std::vector<Distribution1D> conditional;
+	Distribution1D marginal;
+
+	Distribution2D() = default;
+	Distribution2D(const float* f, int nu, int nv);
+
+	void sample(float u0, float u1, float& u, float& v, float& pdf) const;
+	float pdf(float u, float v) const;
+};
+
+// Walker's alias table for O(1) sampling of a discrete distribution
+// proportional to n non-negative weights.
+struct AliasTable {
+	struct Bin {
+		float q; // probability of keeping the bin instead of taking its alias
+		uint32_t alias;
+	};
+
+	std::vector<Bin> bins;
+	std::vector<float> pmfs;
+
+	AliasTable() = default;
+	AliasTable(const float* weights, int n);
+
+	int count() const { return bins.size(); }
+
+	// Maps a uniform u in [0, 1) to an index, returns its probability in pmf.
+	int sample(float u, float& pmf) const;
+	float pmf(int i) const { return pmfs[i]; }
+};
+
+#endif
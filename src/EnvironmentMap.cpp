@@ -1,83 +1,293 @@
 #include "EnvironmentMap.h"
+#include "Prng.h"
+#include "mathutils.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
+
+#include <sys/stat.h>
 
-Vec3 rgbeToColor(RGBE data) {
-	float f = ldexp(1.0f, data.e - (int)(128 + 8));
-	return Vec3(data.r * f, data.g * f, data.b * f);
-}
+namespace {
 
-EnvironmentMap::EnvironmentMap(std::istream& file) {
-	std::string line;
+// Conversions between non-negative floats and halfs by rebasing the exponent
+// through a multiply, which also covers denormals. Values beyond the half
+// range are clamped to its largest finite value.
+uint16_t floatToHalf(float f) {
+	f = std::min(std::max(f, 0.0f), 65504.0f) * 1.925929944387236e-34f;
+	uint32_t bits;
+	memcpy(&bits, &f, 4);
+	return uint16_t((bits + 0x1000) >> 13);
+}
 
-	do {
-		std::getline(file, line);
-	} while (!line.empty());
+float halfToFloat(uint16_t h) {
+	uint32_t bits = uint32_t(h & 0x7fff) << 13;
+	float f;
+	memcpy(&f, &bits, 4);
+	return f * 5.192296858534828e+33f;
+}
 
-	// -Y 512 +X 1024
-	std::getline(file, line);
+const char kCacheMagic[8] = { 'R', 'A', 'Y', 'E', 'N', 'V', 0, 0 };
+const uint32_t kCacheVersion = 2;
+// texels start here, past the header and aligned for any texel type
+const size_t kCacheDataOffset = 64;
 
-	size_t a = line.find(' ', 0);
-	size_t b = line.find(' ', a + 1);
-	size_t c = line.find(' ', b + 1);
+struct CacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t format;
+	uint32_t mapping;
+	uint32_t width;
+	uint32_t height;
+	uint32_t reserved;
+	// size and modification time of the .hdr file the cache was made from
+	uint64_t sourceSize;
+	int64_t sourceTime;
+};
 
-	width = std::stoi(line.substr(c + 1));
-	height = std::stoi(line.substr(a + 1, b - a - 1));
-	data = new RGBE[width * height];
+size_t texelSize(EnvFormat format) {
+	switch (format) {
+	case EnvFormat::Half: return 3 * sizeof(uint16_t);
+	case EnvFormat::Rgbe: return sizeof(RGBE);
+	default: return 3 * sizeof(float);
+	}
+}
 
-	RGBE p;
-	uint8_t buf[2];
+// Zero size and time if the file cannot be read.
+void fileStamp(const std::string& filename, uint64_t& size, int64_t& time) {
+	struct stat info;
+	bool found = stat(filename.c_str(), &info) == 0;
+	size = found ? (uint64_t)info.st_size : 0;
+	time = found ? (int64_t)info.st_mtime : 0;
+}
 
-	for (int y = 0; y < height; y++) {
-		file.read((char*)&p, sizeof(p));
-		for (int i = 0; i < 4; i++) {
-			uint8_t* ptr = (uint8_t*)(&data[y * width]) + i;
-			for (int x = 0; x < width;) {
-				file.read((char*)buf, 2);
-				if (buf[0] > 128) {
-					int count = buf[0] - 128;
-					if (count == 0 || count > width - x) {
-						exit(1);
-					}
-					x += count;
-					while (count-- > 0) {
-						*ptr = buf[1];
-						ptr += sizeof(RGBE);
-					}
-				}
-				else {
-					int count = buf[0];
-					if (count == 0 || count > width - x) {
-						exit(1);
-					}
-					x += count;
-					*ptr = buf[1];
-					ptr += sizeof(RGBE);
-					while (--count > 0) {
-						file.read((char*)ptr, 1);
-						ptr += sizeof(RGBE);
-					}
-				}
+}
+
+EnvironmentMap* EnvironmentMap::load(const std::string& filename, const EnvironmentOptions& options) {
+	auto cacheName = filename + ".envcache";
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	fileStamp(filename, sourceSize, sourceTime);
+
+	if (options.cache) {
+		auto map = new EnvironmentMap();
+		if (map->readCache(cacheName, options, sourceSize, sourceTime)) return map;
+		delete map;
+	}
+
+	MappedFile source;
+	if (!source.open(filename)) throw std::runtime_error("cannot open " + filename);
+	auto map = new EnvironmentMap(decodeHdr(source.data(), source.size()), options);
+	if (options.cache) map->writeCache(cacheName, sourceSize, sourceTime);
+	return map;
+}
+
+EnvironmentMap::EnvironmentMap(std::istream& file, const EnvironmentOptions& options) : EnvironmentMap(readHdr(file), options) {
+}
+
+EnvironmentMap::EnvironmentMap(const HdrImage& image, const EnvironmentOptions& options) :
+	width(image.width), height(image.height), format(options.format), mapping(options.mapping) {
+	if (mapping == EnvMapping::Octahedral) {
+		// resample at about the same texel count, nearest texel of the file
+		int latWidth = width;
+		int latHeight = height;
+		int size = std::max(1, (int)sqrtf(float(width) * height));
+		width = height = size;
+		std::vector<Vec3> octahedral(size * size);
+		for (int y = 0; y < size; y++) {
+			for (int x = 0; x < size; x++) {
+				auto dir = texcoordToVector(x + 0.5f, y + 0.5f);
+				int lx = int(latWidth / 2 + atan2f(dir.x, dir.z) / M_PI * latWidth * 0.5f) % latWidth;
+				int ly = std::min(int(acosf(clamp(-1, 1, dir.y)) / M_PI * latHeight), latHeight - 1);
+				octahedral[y * size + x] = image.pixels[ly * latWidth + lx];
 			}
 		}
+		store(octahedral);
+	}
+	else {
+		store(image.pixels);
 	}
+
+	buildDistribution();
 }
 
-Vec3 EnvironmentMap::texcoordToVector(float x, float y) {
-	float theta = (0.75f - (x + 0.5f) / width) * 2 * M_PI;
-	float phi = (0.5f - (y + 0.5f) / height) * 0.5f * M_PI;
+// Inverse of the mapping in sample(), x and y in pixels.
+Vec3 EnvironmentMap::texcoordToVector(float x, float y) const {
+	if (mapping == EnvMapping::Octahedral) {
+		// the upper hemisphere is the center diamond, the lower one folded over the corners
+		float u = x / width * 2 - 1;
+		float v = y / height * 2 - 1;
+		float up = 1 - fabsf(u) - fabsf(v);
+		if (up < 0) {
+			float fu = (1 - fabsf(v)) * (u < 0 ? -1 : 1);
+			float fv = (1 - fabsf(u)) * (v < 0 ? -1 : 1);
+			u = fu;
+			v = fv;
+		}
+		return normalized(Vec3(u, up, v));
+	}
+
+	float theta = y / height * M_PI;
+	float phi = (x / width - 0.5f) * 2 * M_PI;
+	float sinTheta = sinf(theta);
 	return Vec3(
-		::cos(phi) * ::cos(theta),
-		::sin(phi),
-		::cos(phi) * ::sin(theta)
+		sinTheta * sinf(phi),
+		cosf(theta),
+		sinTheta * cosf(phi)
 	);
 }
 
-Vec3 EnvironmentMap::sample(const Vec3& dir) {
+int EnvironmentMap::texelIndex(const Vec3& dir) const {
+	if (mapping == EnvMapping::Octahedral) {
+		float l1 = fabsf(dir.x) + fabsf(dir.y) + fabsf(dir.z);
+		float u = dir.x / l1;
+		float v = dir.z / l1;
+		if (dir.y < 0) {
+			float fu = (1 - fabsf(v)) * (u < 0 ? -1 : 1);
+			float fv = (1 - fabsf(u)) * (v < 0 ? -1 : 1);
+			u = fu;
+			v = fv;
+		}
+		int x = std::min(int((u + 1) * 0.5f * width), width - 1);
+		int y = std::min(int((v + 1) * 0.5f * height), height - 1);
+		return y * width + x;
+	}
+
 	unsigned int x = width / 2 + ::atan2(dir.x, dir.z) / M_PI * width * 0.5f;
 	unsigned int y = (1 - ::asin(dir.y) / M_PI * 2) * height * 0.5f;
 	x %= width;
 	y %= height;
-	return rgbeToColor(data[y * width + x]);
-}
\ No newline at end of file
+	return y * width + x;
+}
+
+float EnvironmentMap::jacobian(const Vec3& dir) const {
+	if (mapping == EnvMapping::Octahedral) {
+		// the map is [-1, 1]^2 onto the octahedron |x| + |y| + |z| = 1, where
+		// a point q covers a solid angle of dA / |q|^3
+		float l1 = fabsf(dir.x) + fabsf(dir.y) + fabsf(dir.z);
+		return 4 * l1 * l1 * l1;
+	}
+
+	float y = fmaxf(-1, fminf(1, dir.y));
+	return 2 * M_PI * M_PI * sqrtf(1 - y * y);
+}
+
+Vec3 EnvironmentMap::texel(int x, int y) const {
+	int i = y * width + x;
+	switch (format) {
+	case EnvFormat::Half: {
+		auto h = (const uint16_t*)texels + i * 3;
+		return Vec3(halfToFloat(h[0]), halfToFloat(h[1]), halfToFloat(h[2]));
+	}
+	case EnvFormat::Rgbe:
+		return rgbeToColor(((const RGBE*)texels)[i]);
+	default: {
+		auto f = (const float*)texels + i * 3;
+		return Vec3(f[0], f[1], f[2]);
+	}
+	}
+}
+
+Vec3 EnvironmentMap::sample(const Vec3& dir) const {
+	int i = texelIndex(dir);
+	return texel(i % width, i / width);
+}
+
+void EnvironmentMap::store(const std::vector<Vec3>& pixels) {
+	storage.resize(pixels.size() * texelSize(format));
+	for (size_t i = 0; i < pixels.size(); i++) {
+		auto& c = pixels[i];
+		switch (format) {
+		case EnvFormat::Half: {
+			auto h = (uint16_t*)storage.data() + i * 3;
+			h[0] = floatToHalf(c.x);
+			h[1] = floatToHalf(c.y);
+			h[2] = floatToHalf(c.z);
+			break;
+		}
+		case EnvFormat::Rgbe:
+			((RGBE*)storage.data())[i] = colorToRgbe(c);
+			break;
+		default: {
+			auto f = (float*)storage.data() + i * 3;
+			f[0] = c.x;
+			f[1] = c.y;
+			f[2] = c.z;
+		}
+		}
+	}
+	texels = storage.data();
+}
+
+bool EnvironmentMap::readCache(const std::string& filename, const EnvironmentOptions& options, uint64_t sourceSize, int64_t sourceTime) {
+	if (!cacheFile.open(filename)) return false;
+
+	CacheHeader header;
+	if (cacheFile.size() < kCacheDataOffset) return false;
+	memcpy(&header, cacheFile.data(), sizeof(header));
+	if (memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0) return false;
+	if (header.version != kCacheVersion || header.sourceSize != sourceSize || header.sourceTime != sourceTime) return false;
+	if (header.format != (uint32_t)options.format || header.mapping != (uint32_t)options.mapping) return false;
+	if (cacheFile.size() != kCacheDataOffset + uint64_t(header.width) * header.height * texelSize(options.format)) return false;
+
+	width = header.width;
+	height = header.height;
+	format = options.format;
+	mapping = options.mapping;
+	texels = cacheFile.data() + kCacheDataOffset;
+	buildDistribution();
+	return true;
+}
+
+void EnvironmentMap::writeCache(const std::string& filename, uint64_t sourceSize, int64_t sourceTime) const {
+	CacheHeader header = {};
+	memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+	header.version = kCacheVersion;
+	header.format = (uint32_t)format;
+	header.mapping = (uint32_t)mapping;
+	header.width = width;
+	header.height = height;
+	header.sourceSize = sourceSize;
+	header.sourceTime = sourceTime;
+
+	// a cache that cannot be written only costs the next load its time
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	char padding[kCacheDataOffset] = {};
+	file.write((const char*)&header, sizeof(header));
+	file.write(padding, kCacheDataOffset - sizeof(header));
+	file.write((const char*)texels, size_t(width) * height * texelSize(format));
+}
+
+void EnvironmentMap::buildDistribution() {
+	std::vector<float> weights(width * height);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			// texels near the poles of a lat-long map cover less solid angle
+			float area = jacobian(texcoordToVector(x + 0.5f, y + 0.5f));
+			weights[y * width + x] = luminance(texel(x, y)) * area;
+		}
+	}
+	distribution = Distribution2D(weights.data(), width, height);
+}
+
+Vec3 EnvironmentMap::sampleDirection(Prng& prng, float& pdf) const {
+	float u, v, mapPdf;
+	distribution.sample(prng.frand(0, 1), prng.frand(0, 1), u, v, mapPdf);
+
+	auto dir = texcoordToVector(u * width, v * height);
+	float j = jacobian(dir);
+	pdf = j > 0 ? mapPdf / j : 0;
+	return dir;
+}
+
+float EnvironmentMap::pdf(const Vec3& dir) const {
+	float j = jacobian(dir);
+	if (j <= 0) return 0;
+
+	int i = texelIndex(dir);
+	return distribution.pdf((i % width + 0.5f) / width, (i / width + 0.5f) / height) / j;
+}
@@ -2,35 +2,77 @@
 #define EnvironmentMap_h
 
 #include "Vec3.h"
+#include "Distribution.h"
+#include "HdrImage.h"
+#include "MappedFile.h"
 
 #include <vector>
 #include <istream>
+#include <string>
 #include <cstdint>
 
-struct RGBE {
-	uint8_t r;
-	uint8_t g;
-	uint8_t b;
-	uint8_t e;
+class Prng;
+
+// How the texels of an environment map are stored in memory.
+enum class EnvFormat : uint32_t {
+	Float, // 3 floats per texel
+	Half,  // 3 halfs per texel
+	Rgbe,  // shared exponent bytes as in the file, decoded through a table
+};
+
+// How directions map onto the texels.
+enum class EnvMapping : uint32_t {
+	// equirectangular as stored in the file, lookups need atan2 and asin
+	LatLong,
+	// square octahedral map resampled from the file, lookups need no trig
+	Octahedral,
 };
 
-struct EnvLight {
-	Vec3 dir;
-	Vec3 color;
+struct EnvironmentOptions {
+	EnvFormat format = EnvFormat::Float;
+	EnvMapping mapping = EnvMapping::LatLong;
+	// Writes the converted texels next to the file and memory maps them on the
+	// next load instead of decoding the file again.
+	bool cache = false;
 };
 
 struct EnvironmentMap {
-    RGBE* data;
-    int width;
-    int height;
-	std::vector<EnvLight> lights;
+	int width;
+	int height;
+	EnvFormat format;
+	EnvMapping mapping;
+	// Luminance times solid angle of each texel, for importance sampling.
+	Distribution2D distribution;
 
-	EnvironmentMap(std::istream& file);
+	EnvironmentMap(const HdrImage& image, const EnvironmentOptions& options = EnvironmentOptions());
+	EnvironmentMap(std::istream& file, const EnvironmentOptions& options = EnvironmentOptions());
+	// Loads an .hdr file, through its cache file if options.cache is set.
+	// Throws std::runtime_error if the file cannot be read or decoded.
+	static EnvironmentMap* load(const std::string& filename, const EnvironmentOptions& options = EnvironmentOptions());
 
-    Vec3 sample(const Vec3& dir);
-	Vec3 texcoordToVector(float x, float y);
-};
+	Vec3 sample(const Vec3& dir) const;
+	Vec3 texel(int x, int y) const;
+	// Direction through a point of the map, x and y in pixels.
+	Vec3 texcoordToVector(float x, float y) const;
 
-Vec3 rgbeToColor(RGBE data);
+	// Picks a direction proportional to incoming radiance, pdf is per solid angle.
+	Vec3 sampleDirection(Prng& prng, float& pdf) const;
+	float pdf(const Vec3& dir) const;
+
+private:
+	EnvironmentMap() = default;
+	void store(const std::vector<Vec3>& pixels);
+	bool readCache(const std::string& filename, const EnvironmentOptions& options, uint64_t sourceSize, int64_t sourceTime);
+	void writeCache(const std::string& filename, uint64_t sourceSize, int64_t sourceTime) const;
+	void buildDistribution();
+	// Texel containing a direction.
+	int texelIndex(const Vec3& dir) const;
+	// Solid angle of a texel over its area in [0, 1)^2 texture space, at dir.
+	float jacobian(const Vec3& dir) const;
+
+	const uint8_t* texels = nullptr; // into storage or the mapped cache file
+	std::vector<uint8_t> storage;
+	MappedFile cacheFile;
+};
 
-#endif
\ No newline at end of file
+#endif
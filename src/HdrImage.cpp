@@ -0,0 +1,255 @@
+#include "HdrImage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+// 2^(e - 136): the scale of a shared exponent, including the 1/256 of the mantissa bytes.
+struct ExponentTable {
+	float scale[256];
+
+	ExponentTable() {
+		scale[0] = 0;
+		for (int e = 1; e < 256; e++) scale[e] = ldexpf(1.0f, e - (128 + 8));
+	}
+};
+
+const ExponentTable exponents;
+
+// Largest image accepted, well beyond any real environment map.
+const int64_t kMaxPixels = int64_t(1) << 28;
+
+void fail(const std::string& message) {
+	throw std::runtime_error("hdr: " + message);
+}
+
+std::string readLine(const uint8_t*& p, const uint8_t* end) {
+	auto newline = std::find(p, end, '\n');
+	if (newline == end) fail("truncated header");
+	std::string line(p, newline);
+	p = newline + 1;
+	return line;
+}
+
+// Where scanline s of the file and pixel i within it land in the top-down,
+// left-to-right output, from a resolution string such as "-Y 512 +X 1024".
+struct Orientation {
+	bool columns;  // scanlines run along Y instead of X
+	bool flipMajor; // scanlines go against the output order
+	bool flipMinor; // pixels within a scanline go against it
+	int scanlines;
+	int length;
+
+	int index(int s, int i, int width) const {
+		if (flipMajor) s = scanlines - 1 - s;
+		if (flipMinor) i = length - 1 - i;
+		return columns ? i * width + s : s * width + i;
+	}
+};
+
+Orientation parseResolution(const std::string& line, int& width, int& height) {
+	char sign[2], axis[2];
+	int size[2];
+	if (sscanf(line.c_str(), "%c%c %d %c%c %d", &sign[0], &axis[0], &size[0], &sign[1], &axis[1], &size[1]) != 6) {
+		fail("bad resolution line '" + line + "'");
+	}
+	for (int i = 0; i < 2; i++) {
+		if ((sign[i] != '+' && sign[i] != '-') || (axis[i] != 'X' && axis[i] != 'Y') || size[i] <= 0) {
+			fail("bad resolution line '" + line + "'");
+		}
+	}
+	if (axis[0] == axis[1]) fail("bad resolution line '" + line + "'");
+	if (int64_t(size[0]) * size[1] > kMaxPixels) fail("image too large");
+
+	// -Y is top to bottom and +X left to right, the order of the output
+	Orientation o;
+	o.columns = axis[0] == 'X';
+	o.flipMajor = sign[0] == (o.columns ? '-' : '+');
+	o.flipMinor = sign[1] == (o.columns ? '+' : '-');
+	o.scanlines = size[0];
+	o.length = size[1];
+	width = o.columns ? size[0] : size[1];
+	height = o.columns ? size[1] : size[0];
+	return o;
+}
+
+// Walks the scanline of length pixels starting at p and returns its end,
+// validating every run. Writes the pixels to out unless it is null, so the
+// same code builds the offset index and decodes.
+const uint8_t* scanline(const uint8_t* p, const uint8_t* end, int length, RGBE* out) {
+	bool rle = length >= 8 && length < 0x8000 && end - p >= 4 && p[0] == 2 && p[1] == 2 && (p[2] & 0x80) == 0;
+	if (rle) {
+		if ((p[2] << 8 | p[3]) != length) fail("scanline length mismatch");
+		p += 4;
+		// each of the four components is run length encoded separately
+		for (int c = 0; c < 4; c++) {
+			auto component = out ? (uint8_t*)out + c : nullptr;
+			for (int x = 0; x < length;) {
+				if (end - p < 2) fail("truncated scanline");
+				int count = p[0];
+				bool run = count > 128;
+				if (run) count -= 128;
+				if (count == 0 || count > length - x) fail("bad run length");
+				if (!run && end - p < 1 + count) fail("truncated scanline");
+				if (component) {
+					for (int i = 0; i < count; i++) component[(x + i) * 4] = run ? p[1] : p[1 + i];
+				}
+				p += run ? 2 : 1 + count;
+				x += count;
+			}
+		}
+		return p;
+	}
+
+	// flat pixels, where 1 1 1 n repeats the previous pixel n times, shifted
+	// left by 8 more bits for each consecutive repeat
+	int shift = 0;
+	for (int x = 0; x < length; p += 4) {
+		if (end - p < 4) fail("truncated scanline");
+		if (p[0] == 1 && p[1] == 1 && p[2] == 1) {
+			if (x == 0 || shift > 16) fail("bad repeat");
+			int count = p[3] << shift;
+			if (count > length - x) fail("bad run length");
+			if (out) std::fill(out + x, out + x + count, out[x - 1]);
+			x += count;
+			shift += 8;
+		}
+		else {
+			if (out) out[x] = RGBE{ p[0], p[1], p[2], p[3] };
+			x++;
+			shift = 0;
+		}
+	}
+	return p;
+}
+
+Vec3 xyzToRgb(const Vec3& c) {
+	return Vec3(
+		3.2404542f * c.x - 1.5371385f * c.y - 0.4985314f * c.z,
+		-0.9692660f * c.x + 1.8760108f * c.y + 0.0415560f * c.z,
+		0.0556434f * c.x - 0.2040259f * c.y + 1.0572252f * c.z
+	);
+}
+
+}
+
+Vec3 rgbeToColor(RGBE data) {
+	float f = exponents.scale[data.e];
+	return Vec3(data.r * f, data.g * f, data.b * f);
+}
+
+RGBE colorToRgbe(const Vec3& c) {
+	float v = std::max(c.x, std::max(c.y, c.z));
+	if (!(v >= 1e-32f)) return RGBE{ 0, 0, 0, 0 };
+	int e;
+	float f = frexpf(v, &e) * 256 / v;
+	return RGBE{ uint8_t(std::max(c.x, 0.0f) * f), uint8_t(std::max(c.y, 0.0f) * f), uint8_t(std::max(c.z, 0.0f) * f), uint8_t(e + 128) };
+}
+
+HdrImage decodeHdr(const uint8_t* data, size_t size) {
+	const uint8_t* p = data;
+	const uint8_t* end = data + size;
+
+	auto magic = readLine(p, end);
+	if (magic.compare(0, 2, "#?") != 0) fail("not a Radiance file");
+
+	bool xyz = false;
+	for (;;) {
+		auto line = readLine(p, end);
+		if (line.empty()) break;
+		if (line == "FORMAT=32-bit_rle_xyze") xyz = true;
+		else if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe") fail("unsupported " + line);
+	}
+
+	HdrImage image;
+	auto orientation = parseResolution(readLine(p, end), image.width, image.height);
+	int scanlines = orientation.scanlines;
+	int length = orientation.length;
+
+	// RLE scanlines vary in size, so find where each one starts first
+	std::vector<const uint8_t*> offsets(scanlines);
+	for (int s = 0; s < scanlines; s++) {
+		offsets[s] = p;
+		p = scanline(p, end, length, nullptr);
+	}
+
+	image.pixels.resize(size_t(image.width) * image.height);
+	auto decode = [&](int first, int last) {
+		std::vector<RGBE> rgbe(length);
+		for (int s = first; s < last; s++) {
+			scanline(offsets[s], end, length, rgbe.data());
+			for (int i = 0; i < length; i++) {
+				auto c = rgbeToColor(rgbe[i]);
+				image.pixels[orientation.index(s, i, image.width)] = xyz ? xyzToRgb(c) : c;
+			}
+		}
+	};
+
+	int threads = std::max(1, std::min((int)std::thread::hardware_concurrency(), scanlines / 16));
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threads; t++) {
+		workers.emplace_back(decode, scanlines * t / threads, scanlines * (t + 1) / threads);
+	}
+	decode(0, scanlines / threads);
+	for (auto& worker : workers) worker.join();
+	return image;
+}
+
+HdrImage readHdr(std::istream& file) {
+	std::vector<uint8_t> data;
+	char chunk[1 << 16];
+	while (file.read(chunk, sizeof(chunk)) || file.gcount() > 0) {
+		data.insert(data.end(), chunk, chunk + file.gcount());
+	}
+	return decodeHdr(data.data(), data.size());
+}
+
+void writeHdr(std::ostream& file, const HdrImage& image) {
+	file << "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " << image.height << " +X " << image.width << "\n";
+
+	int width = image.width;
+	std::vector<RGBE> rgbe(width);
+	std::vector<uint8_t> out;
+	for (int y = 0; y < image.height; y++) {
+		for (int x = 0; x < width; x++) rgbe[x] = colorToRgbe(image.pixels[size_t(y) * width + x]);
+		if (width < 8 || width > 0x7fff) {
+			// too narrow or wide for RLE
+			file.write((const char*)rgbe.data(), width * sizeof(RGBE));
+			continue;
+		}
+
+		// a flat scanline could start like an RLE header, so always encode
+		out.assign({ 2, 2, uint8_t(width >> 8), uint8_t(width & 0xff) });
+		for (int c = 0; c < 4; c++) {
+			auto byte = [&](int x) { return (&rgbe[x].r)[c]; };
+			int x = 0;
+			while (x < width) {
+				int run = 1;
+				while (x + run < width && run < 127 && byte(x + run) == byte(x)) run++;
+				if (run >= 4) {
+					out.push_back(uint8_t(128 + run));
+					out.push_back(byte(x));
+					x += run;
+					continue;
+				}
+				// literals up to the next run of four
+				int count = 0;
+				while (x + count < width && count < 128) {
+					int same = 1;
+					while (x + count + same < width && same < 4 && byte(x + count + same) == byte(x + count)) same++;
+					if (same >= 4) break;
+					count++;
+				}
+				out.push_back(uint8_t(count));
+				for (int i = 0; i < count; i++) out.push_back(byte(x + i));
+				x += count;
+			}
+		}
+		file.write((const char*)out.data(), out.size());
+	}
+}
@@ -0,0 +1,39 @@
+#ifndef HdrImage_h
+#define HdrImage_h
+
+#include "Vec3.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+struct RGBE {
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+	uint8_t e;
+};
+
+Vec3 rgbeToColor(RGBE data);
+RGBE colorToRgbe(const Vec3& c);
+
+// Linear pixels of a Radiance .hdr file, top row first and left to right
+// whatever the orientation stored in the file.
+struct HdrImage {
+	int width = 0;
+	int height = 0;
+	std::vector<Vec3> pixels;
+};
+
+// Decodes a whole .hdr file in memory, RLE or flat scanlines in RGBE or XYZE.
+// Scanlines are located in one pass and decoded in parallel. Throws
+// std::runtime_error on malformed or truncated data.
+HdrImage decodeHdr(const uint8_t* data, size_t size);
+HdrImage readHdr(std::istream& file);
+// Writes a top-down RGBE file. Scanlines 8 to 0x7fff pixels wide are run
+// length encoded per channel, narrower or wider ones are written flat.
+void writeHdr(std::ostream& file, const HdrImage& image);
+
+#endif
@@ -0,0 +1,147 @@
+#include "Headless.h"
+#include "Tracer.h"
+#include "Sequence.h"
+#include "Distributed.h"
+#include "Accumulation.h"
+#include "Checkpoint.h"
+#include "RenderLimits.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// std::stoi for counts and sizes; values below min fail like malformed ones
+int parseInt(const std::string& value, int min) {
+	int n = std::stoi(value);
+	if (n < min) throw std::out_of_range(value);
+	return n;
+}
+
+}
+
+int runHeadless(Tracer& tracer, int argc, char** argv) {
+	std::string frame;
+	std::string pathFile;
+	std::string worker;
+	std::string job;
+	std::string checkpoint;
+	double checkpointInterval = 60;
+	std::string output;
+	bool coordinator = false;
+	SequenceSettings settings;
+	DistributedSettings distributed;
+	int width = tracer.width;
+	int height = tracer.height;
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			if (i + 1 >= argc) {
+				std::cerr << "missing value for " << arg << "\n";
+				return 1;
+			}
+			std::string value = argv[++i];
+			try {
+				if (arg == "--frame") frame = value;
+				else if (arg == "--sequence") pathFile = value;
+				else if (arg == "--frames") settings.frames = std::stoi(value);
+				else if (arg == "--spp") settings.limits.spp = distributed.spp = parseInt(value, 0);
+				else if (arg == "--time") settings.limits.seconds = std::stod(value);
+				else if (arg == "--noise") settings.limits.noise = std::stof(value);
+				else if (arg == "--out") output = value;
+				else if (arg == "--width") width = parseInt(value, 1);
+				else if (arg == "--height") height = parseInt(value, 1);
+				else if (arg == "--exposure") settings.exposure = std::stof(value);
+				else if (arg == "--seed") tracer.seed(std::stoul(value));
+				else if (arg == "--coordinator") {
+					coordinator = true;
+					distributed.port = std::stoi(value);
+				}
+				else if (arg == "--workers") distributed.workers = parseInt(value, 1);
+				else if (arg == "--tile-size") distributed.tileSize = parseInt(value, 1);
+				else if (arg == "--tile-spp") distributed.tileSamples = std::stoi(value);
+				else if (arg == "--worker") worker = value;
+				else if (arg == "--job") job = value;
+				else if (arg == "--first-sample") tracer.firstSample = std::stoi(value);
+				else if (arg == "--checkpoint") checkpoint = value;
+				else if (arg == "--checkpoint-interval") checkpointInterval = std::stod(value);
+				else {
+					std::cerr << "unknown option " << arg << "\n";
+					return 1;
+				}
+			}
+			catch (const std::logic_error&) {
+				// std::stoi and friends on a malformed or out of range number
+				throw std::runtime_error("bad value for " + arg + ": " + value);
+			}
+		}
+
+		if (!settings.limits.any()) settings.limits.spp = 16;
+
+		if (!worker.empty()) {
+			auto colon = worker.rfind(':');
+			auto port = colon == std::string::npos ? std::string() : worker.substr(colon + 1);
+			if (port.empty() || port.find_first_not_of("0123456789") != std::string::npos || port.size() > 5 || std::stoi(port) > 65535) {
+				throw std::runtime_error("--worker expects host:port");
+			}
+			work(tracer, worker.substr(0, colon), std::stoi(port));
+		}
+		else if (!job.empty()) {
+			// one of several jobs with disjoint sample ranges, merged by ray-merge
+			tracer.resize(width, height);
+			std::unique_ptr<Checkpointer> checkpointer;
+			if (!checkpoint.empty()) {
+				if (resume(tracer, checkpoint)) std::cout << "resuming after " << tracer.numSamples << " samples\n";
+				checkpointer.reset(new Checkpointer(checkpoint));
+			}
+			auto saved = std::chrono::steady_clock::now();
+			auto stats = renderUntil(tracer, settings.limits, [&] {
+				auto now = std::chrono::steady_clock::now();
+				if (checkpointer && std::chrono::duration<double>(now - saved).count() >= checkpointInterval) {
+					checkpointer->save(tracer);
+					saved = now;
+				}
+			});
+			if (checkpointer) {
+				checkpointer->save(tracer);
+				checkpointer->flush();
+			}
+			std::ofstream file(job, std::ios::binary);
+			writeAccumulation(file, accumulation(tracer));
+			if (!file) throw std::runtime_error(job + ": write failed");
+			std::cout << job << ": " << describe(stats) << "\n";
+		}
+		else if (!frame.empty()) {
+			tracer.resize(width, height);
+			auto stats = renderUntil(tracer, settings.limits);
+			writeFrame(tracer, frame, settings.exposure);
+			std::cout << frame << ": " << describe(stats) << "\n";
+		}
+		else if (coordinator) {
+			tracer.resize(width, height);
+			coordinate(tracer, distributed);
+			writeFrame(tracer, output.empty() ? "frame.hdr" : output, settings.exposure);
+		}
+		else if (!pathFile.empty()) {
+			std::ifstream file(pathFile);
+			if (!file) throw std::runtime_error(pathFile + ": cannot open");
+			auto path = readCameraPath(file);
+			if (!output.empty()) settings.output = output;
+			tracer.resize(width, height);
+			renderSequence(tracer, path, settings);
+		}
+		else {
+			std::cerr << "usage: ray --frame frame.hdr | --sequence path.txt | --coordinator port | --worker host:port | --job part.acc [options]\n";
+			return 1;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef Headless_h
+#define Headless_h
+
+class Tracer;
+
+// Renders without a window, for the ray binary when it gets arguments and
+// for ray-headless on hosts without SDL:
+// ray --frame frame.hdr
+// ray --sequence path.txt [--frames n] [--out frame####.ppm]
+// ray --coordinator port [--workers n] [--tile-size n] [--tile-spp n] [--out frame.hdr]
+// ray --worker host:port
+// ray --job part.acc [--first-sample n] [--checkpoint file] [--checkpoint-interval seconds]
+// with [--spp n] [--width w] [--height h] [--exposure e] [--seed s]
+// Frames, sequences and jobs stop at the first of --spp n, --time seconds and
+// --noise relative-error, 16 spp if none is given.
+// Prints errors and returns the process exit code.
+int runHeadless(Tracer& tracer, int argc, char** argv);
+
+#endif
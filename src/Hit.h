@@ -1,17 +1,24 @@
 #ifndef Hit_h
 #define Hit_h
 
-struct Material;
-struct Object;
+#include "ObjectRef.h"
+#include "Material.h"
 
 const float kEpsilon = 0.000001f;
 
+// Hits closer than this to the ray origin are ignored. Spawned rays start
+// at offsetRayOrigin, so this only rejects hits at the origin itself.
+const float kMinDistance = 0.0f;
+
 struct Hit {
-	float minDistance = 0.0001f;
+	float minDistance = kMinDistance;
     float distance = 99999;
-    Material* material = nullptr;
-	Object* obj = nullptr;
+    MaterialId material = 0;
+	ObjectRef obj;
+	uint32_t primitive = 0; // triangle of a mesh
+	float uvScale = 0; // uv units per unit of length at the hit, 0 if untextured
 	Vec3 normal;
+	Vec3 shadingNormal = Vec3(0, 0, 0); // interpolated vertex normal, zero where there is none
 	Vec3 uvw;
 };
 
@@ -0,0 +1,75 @@
+#include "Instance.h"
+#include "Mesh.h"
+
+#include <cmath>
+
+Instance::Instance(Mesh* mesh, const Transform& transform): mesh(mesh), toWorld(transform), toObject(transform.inverse()) {
+	material = mesh->material;
+}
+
+void Instance::setTransform(const Transform& transform) {
+	toWorld = transform;
+	toObject = transform.inverse();
+	moving = false;
+}
+
+void Instance::setMotion(const Transform& open, const Transform& close) {
+	setTransform(open);
+	toWorldEnd = close;
+	moving = true;
+}
+
+Transform Instance::toWorldAt(float time) const {
+	return moving ? lerp(toWorld, toWorldEnd, time) : toWorld;
+}
+
+Transform Instance::toObjectAt(float time) const {
+	return moving ? lerp(toWorld, toWorldEnd, time).inverse() : toObject;
+}
+
+bool Instance::intersect(const Ray& ray, Hit* hit) {
+	auto toObject = toObjectAt(ray.time);
+	// The direction is not renormalized so distances stay in world units.
+	Ray local(toObject.point(ray.origin), toObject.vector(ray.direction), ray.time);
+	if (!mesh->intersect(local, hit)) return false;
+
+	if (hit) {
+		hit->normal = normalized(toObject.transposedVector(hit->normal));
+		if (!(hit->shadingNormal == Vec3(0, 0, 0))) hit->shadingNormal = normalized(toObject.transposedVector(hit->shadingNormal));
+	}
+	return true;
+}
+
+bool Instance::occluded(const Ray& ray, float tMax) const {
+	auto toObject = toObjectAt(ray.time);
+	Ray local(toObject.point(ray.origin), toObject.vector(ray.direction), ray.time);
+	return mesh->occluded(local, tMax);
+}
+
+SurfaceSample Instance::sampleSurface(Prng& prng, float time) {
+	auto s = mesh->sampleSurface(prng);
+	s.position = toWorldAt(time).point(s.position);
+	s.normal = normalized(toObjectAt(time).transposedVector(s.normal));
+	return s;
+}
+
+float Instance::getSurfaceArea() {
+	// exact for uniform scale
+	return mesh->getSurfaceArea() * powf(fabsf(toWorld.determinant()), 2.0f / 3.0f);
+}
+
+AABB Instance::getBounds() const {
+	auto& b = mesh->bounds;
+	AABB aabb;
+	for (int i = 0; i < 8; i++) {
+		Vec3 corner(
+			(i & 1) ? b.max.x : b.min.x,
+			(i & 2) ? b.max.y : b.min.y,
+			(i & 4) ? b.max.z : b.min.z
+		);
+		aabb.enclose(toWorld.point(corner));
+		// in between, each corner lies on the line between its two ends
+		if (moving) aabb.enclose(toWorldEnd.point(corner));
+	}
+	return aabb;
+}
@@ -0,0 +1,46 @@
+#ifndef Instance_h
+#define Instance_h
+
+#include "Object.h"
+#include "AABB.h"
+#include "Transform.h"
+
+#include <vector>
+
+struct Mesh;
+
+// A placement of a shared mesh. Rays are moved into the mesh's object space
+// so any number of instances reuse the same triangles and cell grid.
+struct Instance : Object {
+	Mesh* mesh;
+	Transform toWorld; // when the shutter opens
+	Transform toObject;
+	// Placement when the shutter closes, the instance moves linearly from
+	// toWorld to it. Only used when moving is set.
+	Transform toWorldEnd;
+	bool moving = false;
+	// light index of each mesh triangle, empty if the mesh has no emissive triangles
+	std::vector<int32_t> triangleLights;
+
+	Instance(Mesh* mesh, const Transform& transform);
+
+	// Moves the instance. The scene sees the move after Scene::refit.
+	void setTransform(const Transform& transform);
+	// Makes the instance move from open to close during the shutter interval.
+	void setMotion(const Transform& open, const Transform& close);
+	Transform toWorldAt(float time) const;
+	Transform toObjectAt(float time) const;
+
+	bool intersect(const Ray& ray, Hit* hit);
+	bool occluded(const Ray& ray, float tMax) const;
+	SurfaceSample sampleSurface(Prng& prng, float time = 0);
+	// Area when the shutter opens. Light pdfs use it at every shutter time,
+	// which holds for an instance that only translates; one that rotates or
+	// scales changes area along the interpolated transform and gets
+	// approximate pdfs.
+	float getSurfaceArea();
+	// Encloses the instance over the whole shutter interval.
+	AABB getBounds() const;
+};
+
+#endif
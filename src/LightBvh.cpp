@@ -0,0 +1,104 @@
+#include "LightBvh.h"
+
+#include <algorithm>
+
+void LightBvh::build(const std::vector<AABB>& bounds, const std::vector<float>& power) {
+	nodes.clear();
+	leafOf.assign(bounds.size(), 0);
+	if (bounds.empty()) return;
+
+	std::vector<uint32_t> indices(bounds.size());
+	for (size_t i = 0; i < indices.size(); i++) indices[i] = i;
+
+	nodes.push_back(LightBvhNode());
+	nodes[0].parent = 0;
+	buildNode(0, bounds, power, indices.data(), indices.size());
+}
+
+void LightBvh::buildNode(uint32_t nodeIndex, const std::vector<AABB>& bounds, const std::vector<float>& power, uint32_t* indices, size_t count) {
+	AABB nodeBounds;
+	AABB centerBounds;
+	float nodePower = 0;
+	for (size_t i = 0; i < count; i++) {
+		nodeBounds.enclose(bounds[indices[i]]);
+		centerBounds.enclose(bounds[indices[i]].center());
+		nodePower += power[indices[i]];
+	}
+	nodes[nodeIndex].bounds = nodeBounds;
+	nodes[nodeIndex].power = nodePower;
+
+	if (count == 1) {
+		nodes[nodeIndex].first = indices[0];
+		nodes[nodeIndex].leaf = 1;
+		leafOf[indices[0]] = nodeIndex;
+		return;
+	}
+
+	// median split along the longest axis of the light centers
+	auto extent = centerBounds.max - centerBounds.min;
+	int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+	size_t mid = count / 2;
+	std::nth_element(indices, indices + mid, indices + count, [&](uint32_t a, uint32_t b) {
+		return (&bounds[a].min.x)[axis] + (&bounds[a].max.x)[axis] < (&bounds[b].min.x)[axis] + (&bounds[b].max.x)[axis];
+	});
+
+	uint32_t left = nodes.size();
+	nodes.push_back(LightBvhNode());
+	nodes.push_back(LightBvhNode());
+	nodes[nodeIndex].first = left;
+	nodes[nodeIndex].leaf = 0;
+	nodes[left].parent = nodeIndex;
+	nodes[left + 1].parent = nodeIndex;
+
+	buildNode(left, bounds, power, indices, mid);
+	buildNode(left + 1, bounds, power, indices + mid, count - mid);
+}
+
+float LightBvh::importance(const LightBvhNode& node, const Vec3& pos) const {
+	// distance to the box center, but never closer than half its diagonal so
+	// clusters containing the shading point are not overweighted
+	auto d = node.bounds.center() - pos;
+	auto h = (node.bounds.max - node.bounds.min) * 0.5f;
+	float distSq = std::max(dot(d, d), dot(h, h));
+	return node.power / std::max(distSq, 1e-6f);
+}
+
+float LightBvh::probabilityLeft(const LightBvhNode& node, const Vec3& pos) const {
+	float l = importance(nodes[node.first], pos);
+	float r = importance(nodes[node.first + 1], pos);
+	return l + r > 0 ? l / (l + r) : 0.5f;
+}
+
+int LightBvh::sample(const Vec3& pos, float u, float& pmf) const {
+	uint32_t index = 0;
+	pmf = 1;
+	while (!nodes[index].leaf) {
+		auto& node = nodes[index];
+		float p = probabilityLeft(node, pos);
+
+		// reuse u for the next level by rescaling it to [0, 1)
+		if (u < p) {
+			u = std::min(u / p, 0.99999994f);
+			pmf *= p;
+			index = node.first;
+		}
+		else {
+			u = std::min((u - p) / (1 - p), 0.99999994f);
+			pmf *= 1 - p;
+			index = node.first + 1;
+		}
+	}
+	return nodes[index].first;
+}
+
+float LightBvh::pmf(const Vec3& pos, int light) const {
+	float result = 1;
+	uint32_t index = leafOf[light];
+	while (index != 0) {
+		auto& parent = nodes[nodes[index].parent];
+		float p = probabilityLeft(parent, pos);
+		result *= index == parent.first ? p : 1 - p;
+		index = nodes[index].parent;
+	}
+	return result;
+}
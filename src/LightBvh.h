@@ -0,0 +1,43 @@
+#ifndef LightBvh_h
+#define LightBvh_h
+
+#include "AABB.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct LightBvhNode {
+	AABB bounds;
+	float power;    // summed power of all lights below this node
+	uint32_t first; // first of the two adjacent children, or the light index of a leaf
+	uint32_t leaf;  // 1 for leaves, 0 for inner nodes
+	uint32_t parent;
+};
+
+// Hierarchy over the scene's emitters for picking one light in proportion
+// to its estimated contribution at a shading point. Each inner node chooses
+// a child by power over squared distance, so far away or dim clusters of
+// lights are rarely sampled.
+class LightBvh {
+public:
+	void build(const std::vector<AABB>& bounds, const std::vector<float>& power);
+
+	bool empty() const { return nodes.empty(); }
+
+	// Maps a uniform u in [0, 1) to a light index, returns its probability in pmf.
+	int sample(const Vec3& pos, float u, float& pmf) const;
+
+	// Probability of sample() returning light at pos.
+	float pmf(const Vec3& pos, int light) const;
+
+private:
+	float importance(const LightBvhNode& node, const Vec3& pos) const;
+	float probabilityLeft(const LightBvhNode& node, const Vec3& pos) const;
+	void buildNode(uint32_t nodeIndex, const std::vector<AABB>& bounds, const std::vector<float>& power, uint32_t* indices, size_t count);
+
+	std::vector<LightBvhNode> nodes;
+	std::vector<uint32_t> leafOf; // node index of each light
+};
+
+#endif
@@ -0,0 +1,31 @@
+#include "Material.h"
+
+MaterialTable g_materials;
+
+MaterialTable::MaterialTable() {
+	add(Material(Vec3(1, 1, 1)));
+}
+
+MaterialId MaterialTable::add(const Material& material) {
+	materials.push_back(material);
+	return materials.size() - 1;
+}
+
+MaterialId MaterialTable::addTexture(const Texture& texture, const Vec3& emission, float opacity) {
+	return addTexture(texture, Material(Vec3(1, 1, 1), emission, 0.02f, opacity, 0, 1.3f));
+}
+
+MaterialId MaterialTable::addTexture(const Texture& texture, Material material) {
+	material.pattern = MaterialPattern::Texture;
+	material.index = textures.size();
+	textures.push_back(texture);
+	return add(material);
+}
+
+MaterialId MaterialTable::addChecker(const Material& a, const Material& b) {
+	auto second = add(b);
+	auto first = a;
+	first.pattern = MaterialPattern::Checker;
+	first.index = second;
+	return add(first);
+}
@@ -1,9 +1,17 @@
 #ifndef Material_h
 #define Material_h
 
+#include "Vec3.h"
+#include "Texture.h"
+
 #include <cmath>
+#include <cstdint>
 #include <vector>
 
+// Index of a material in the material table.
+typedef uint32_t MaterialId;
+
+// Parameters of a material at one surface point, the input of the bsdf.
 struct MaterialProperties {
 	MaterialProperties(const Vec3& color, const Vec3& emission, float roughness, float opacity, float metallic, float ior) :
 		color(color),
@@ -23,62 +31,72 @@ struct MaterialProperties {
 	float ior;
 };
 
-struct Material {
-	virtual MaterialProperties sample(const Vec3& pos, const Vec3& uvw) = 0;
+enum class MaterialPattern : uint8_t {
+	// the record's properties everywhere
+	Constant,
+	// color and emission from an image texture looked up by uv
+	Texture,
+	// alternates with a second material on a checkerboard in the xz plane
+	Checker,
 };
 
-struct DefaultMaterial: Material {
-	DefaultMaterial(const Vec3& color, const Vec3& emission = Vec3(0, 0, 0), float roughness = 0, float opacity = 1, float metallic = 0, float ior = 1.5f) : props(color, emission, roughness, opacity, metallic, ior) {
+// A material record in the table. Records are plain data, the pattern
+// decides how the properties vary over the surface.
+struct Material {
+	Material(const Vec3& color, const Vec3& emission = Vec3(0, 0, 0), float roughness = 0, float opacity = 1, float metallic = 0, float ior = 1.5f) : props(color, emission, roughness, opacity, metallic, ior) {
 	}
 
-	MaterialProperties sample(const Vec3& pos, const Vec3& uvw) override { return props; }
+	bool isEmissive() const { return !(props.emission == Vec3(0, 0, 0)); }
 
 	MaterialProperties props;
+	MaterialPattern pattern = MaterialPattern::Constant;
+	uint32_t index = 0; // the texture of a Texture pattern, the second material of a Checker
+	// Mesh triangles are only hit from their counter-clockwise side, which
+	// skips the hidden back faces of closed meshes. Read when a mesh is built.
+	bool cullBackfaces = false;
 };
 
-struct Texture {
-	int width;
-	int height;
-	std::vector<Vec3> data;
-
-};
-struct TextureMaterial : Material {
-	
-	MaterialProperties sample(const Vec3& pos, const Vec3& uvw) override {
-		int x = int(texture->height * uvw.x) % texture->width;
-		int y = int(texture->height * uvw.y) % texture->height;
-		if (x < 0) x += texture->width;
-		if (y < 0) y += texture->height;
-
-		auto col = texture->data[y * texture->width + x];
-		
-		return {
-			col,
-			col * col * col * emission * 10,
-			0.02f,
-			opacity,
-			0.0f,
-			1.3f
-		};
-	}
+// All materials of the program in one flat array, so primitives and hits
+// refer to them by id. Material 0 is a plain white diffuse.
+class MaterialTable {
+public:
+	MaterialTable();
 
-	Vec3 emission;
-	Texture* texture;
-	float opacity;
-};
+	MaterialId add(const Material& material);
+	// Emission is scaled by the cube of the texel so only the bright parts glow.
+	MaterialId addTexture(const Texture& texture, const Vec3& emission, float opacity);
+	// The material with its color taken from the texture.
+	MaterialId addTexture(const Texture& texture, Material material);
+	MaterialId addChecker(const Material& a, const Material& b);
 
-struct CheckerMaterial: Material {
-	CheckerMaterial():
-		a(Vec3(0.3, 0.3, 0.3), Vec3(0, 0, 0), 0.0002, 1, 1, 1.5),
-		b(Vec3(0.3, 0.3, 0.3), Vec3(0, 0, 0), 0.00002, 1, 1, 1.5) {
-	}
+	const Material& operator[](MaterialId id) const { return materials[id]; }
+	const Texture& texture(MaterialId id) const { return textures[materials[id].index]; }
 
-	MaterialProperties sample(const Vec3& pos, const Vec3& uvw) override {
-		return (int)(floor(pos.x*0.5) + floor(pos.z*0.5)) % 2 ? a : b;
+	// Properties of the material at a surface point. footprint is the width
+	// in uv units the lookup covers, 0 for a point.
+	MaterialProperties evaluate(MaterialId id, const Vec3& pos, const Vec3& uvw, float footprint = 0) const {
+		auto& material = materials[id];
+		switch (material.pattern) {
+		case MaterialPattern::Texture: {
+			auto col = textures[material.index].sample(uvw.x, uvw.y, footprint, filter);
+			auto props = material.props;
+			props.color = col;
+			props.emission = col * col * col * material.props.emission * 10;
+			return props;
+		}
+		case MaterialPattern::Checker:
+			return (int)(floor(pos.x*0.5) + floor(pos.z*0.5)) % 2 ? material.props : materials[material.index].props;
+		default:
+			return material.props;
+		}
 	}
 
-	MaterialProperties a;
-	MaterialProperties b;
+public:
+	std::vector<Material> materials;
+	std::vector<Texture> textures;
+	TextureFilter filter = TextureFilter::Trilinear;
 };
 
-#endif
\ No newline at end of file
+extern MaterialTable g_materials;
+
+#endif
@@ -1,12 +1,22 @@
 #include "Mesh.h"
-#include "tiny_obj_loader.h"
+#include "ObjFile.h"
+#include "stb_image.h"
 #include <unordered_map>
 #include "Material.h"
 #include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 Vec3 palette[256];
 
 Mesh::Mesh(const std::string& filename) {
+	material = g_materials.add(Material(Vec3(0.9, 0.9, 0.9)));
+	if (filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".obj") == 0) {
+		loadObj(filename);
+		return;
+	}
+
 	auto pal = std::ifstream("textures/colormap.pcx", std::ios::binary);
 	pal.seekg(-768, pal.end);
 	for (int i = 0; i < 256; i++) {
@@ -17,31 +27,57 @@ Mesh::Mesh(const std::string& filename) {
 		palette[i] = Vec3(r, g, b) / 255;
 	}
 
-	material = new DefaultMaterial(Vec3(0.9, 0.9, 0.9));
-	//material = new CheckerMaterial();
-	//loadObj(filename);
-	loadBsp("demo1.bsp");
+	loadBsp(filename);
+}
+
+Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<Triangle>& triangles, MaterialId material) {
+	this->material = material;
+	build(vertices, triangles);
 }
 
 bool operator==(const Vertex& a, const Vertex& b) {
-	return a.color == b.color && a.pos == b.pos && a.uv == b.uv;
+	return a.pos == b.pos && a.normal == b.normal && a.color == b.color && a.uv == b.uv;
 }
 
-namespace std {
-	template<> struct hash<::Vec3> {
-		size_t operator()(::Vec3 const& v) const {
-			return v.x + v.y * 10000 + v.z * 100000000;
+// Mixes the bit patterns of all vertex attributes, so vertices that differ
+// anywhere land in different buckets.
+struct VertexHash {
+	size_t operator()(const Vertex& vertex) const {
+		uint32_t bits[10];
+		memcpy(bits, &vertex.pos, sizeof(Vec3));
+		bits[3] = vertex.normal;
+		memcpy(bits + 4, &vertex.color, sizeof(Vec3));
+		memcpy(bits + 7, &vertex.uv, sizeof(Vec3));
+		uint64_t h = 0x9e3779b97f4a7c15ull;
+		for (auto b : bits) {
+			// -0 and 0 compare equal
+			if (b == 0x80000000u) b = 0;
+			h = (h ^ b) * 0xff51afd7ed558ccdull;
+			h ^= h >> 32;
 		}
-	};
+		return h;
+	}
+};
 
-	template<> struct hash<::Vertex> {
-		size_t operator()(::Vertex const& vertex) const {
-			return ((hash<::Vec3>()(vertex.pos) ^
-				(hash<::Vec3>()(vertex.color) << 1)) >> 1) ^
-				(hash<::Vec3>()(vertex.uv) << 1);
-		}
-	};
-}
+// Indexed geometry for the loaders, which produce a vertex per triangle
+// corner: one vertex per distinct combination of attributes.
+struct VertexSet {
+	std::vector<Vertex> vertices;
+	std::unordered_map<Vertex, uint32_t, VertexHash> indices;
+
+	uint32_t add(const Vertex& vertex) {
+		auto it = indices.emplace(vertex, uint32_t(vertices.size()));
+		if (it.second) vertices.push_back(vertex);
+		return it.first->second;
+	}
+};
+
+// Bounds of a mesh triangle, the primitive of the mesh's BVH.
+struct TriangleBounds {
+	AABB bounds;
+
+	AABB getBounds() const { return bounds; }
+};
 
 AABB enclose(const Vec3& a, const Vec3& b, const Vec3& c) {
 	AABB aabb = AABB();
@@ -145,34 +181,27 @@ struct miptex_s
 
 #pragma pack(pop)
 
-Material* Mesh::loadWal(const std::string& name, int lightLevel, float opacity) {
+MaterialId Mesh::loadWal(const std::string& name, int lightLevel, float opacity) {
 	std::string key = name + "_light:" + std::to_string(lightLevel) + "_opacity:" + std::to_string(opacity);
 	auto it = textures.find(key);
 	if (it != textures.end()) return it->second;
 
-	Material* mat = material;
+	MaterialId mat = material;
 
 	auto file = std::ifstream("textures/" + name + ".wal", std::ios::binary);
 	if (file.is_open() && file.good()) {
 		miptex_s wal;
 		file.read((char*)&wal, sizeof(miptex_s));
-		auto tex = new Texture();
-		tex->width = wal.width;
-		tex->height = wal.height;
-		tex->data.resize(tex->width* tex->height);
+		std::vector<Vec3> pixels(wal.width * wal.height);
 		file.seekg(wal.offsets[0]);
 		for (int y = 0; y < wal.height; y++) {
 			for (int x = 0; x < wal.width; x++) {
 				uint8_t c;
 				file.read((char*)&c, 1);
-				tex->data[y * wal.width + x] = palette[c];
+				pixels[y * wal.width + x] = palette[c];
 			}
 		}
-		auto tmat = new TextureMaterial();
-		tmat->texture = tex;
-		tmat->emission = (float)lightLevel / 2000.0f;
-		tmat->opacity = opacity;
-		mat = tmat;
+		mat = g_materials.addTexture(Texture(wal.width, wal.height, pixels), (float)lightLevel / 2000.0f, opacity);
 	}
 
 	textures[key] = mat;
@@ -222,6 +251,7 @@ void Mesh::loadBsp(const std::string& filename) {
 		std::swap(texinfos[i].u_axis.y, texinfos[i].u_axis.z);
 		std::swap(texinfos[i].v_axis.y, texinfos[i].v_axis.z);
 	}
+	VertexSet unique;
 	std::vector<Triangle> triangles;
 	for (int i = 0; i < numfaces; i++) {
 		int startIndex;
@@ -247,18 +277,24 @@ void Mesh::loadBsp(const std::string& filename) {
 				auto v1 = vertices[a];
 				auto v2 = vertices[b];
 				float opacity = 1;
-				auto wal = (TextureMaterial*)loadWal(texinfo.texture_name, (texinfo.flags & 1) ? texinfo.value : 0, opacity);
-				v0.uv.x = (dot(v0.pos * 100, texinfo.u_axis) + texinfo.u_offset) / wal->texture->height;
-				v0.uv.y = (dot(v0.pos * 100, texinfo.v_axis) + texinfo.v_offset) / wal->texture->height;
-				v1.uv.x = (dot(v1.pos * 100, texinfo.u_axis) + texinfo.u_offset) / wal->texture->height;
-				v1.uv.y = (dot(v1.pos * 100, texinfo.v_axis) + texinfo.v_offset) / wal->texture->height;
-				v2.uv.x = (dot(v2.pos * 100, texinfo.u_axis) + texinfo.u_offset) / wal->texture->height;
-				v2.uv.y = (dot(v2.pos * 100, texinfo.v_axis) + texinfo.v_offset) / wal->texture->height;
+				auto wal = loadWal(texinfo.texture_name, (texinfo.flags & 1) ? texinfo.value : 0, opacity);
+				// a missing texture falls back to the untextured mesh material
+				float texWidth = 1, texHeight = 1;
+				if (g_materials[wal].pattern == MaterialPattern::Texture) {
+					texWidth = g_materials.texture(wal).width;
+					texHeight = g_materials.texture(wal).height;
+				}
+				v0.uv.x = (dot(v0.pos * 100, texinfo.u_axis) + texinfo.u_offset) / texWidth;
+				v0.uv.y = (dot(v0.pos * 100, texinfo.v_axis) + texinfo.v_offset) / texHeight;
+				v1.uv.x = (dot(v1.pos * 100, texinfo.u_axis) + texinfo.u_offset) / texWidth;
+				v1.uv.y = (dot(v1.pos * 100, texinfo.v_axis) + texinfo.v_offset) / texHeight;
+				v2.uv.x = (dot(v2.pos * 100, texinfo.u_axis) + texinfo.u_offset) / texWidth;
+				v2.uv.y = (dot(v2.pos * 100, texinfo.v_axis) + texinfo.v_offset) / texHeight;
 				/*
 				u = x * u_axis.x + y * u_axis.y + z * u_axis.z + u_offset
 				v = x * v_axis.x + y * v_axis.y + z * v_axis.z + v_offset
 				*/
-				triangles.push_back({ v0, v1, v2, wal });
+				triangles.push_back({ { unique.add(v0), unique.add(v1), unique.add(v2) }, wal });
 			}
 		}
 	}
@@ -312,182 +348,192 @@ void Mesh::loadBsp(const std::string& filename) {
 		wal
 	});*/
 
-	Vec3 numcells = (bounds.max - bounds.min) * 0.5;
-	numcells.x = 1 + (int)numcells.x;
-	numcells.y = 1 + (int)numcells.y;
-	numcells.z = 1 + (int)numcells.z;
-	Vec3 cellsize = (bounds.max - bounds.min) / numcells;
-	for (int x = 0; x < numcells.x; x++) {
-		for (int y = 0; y < numcells.y; y++) {
-			for (int z = 0; z < numcells.z; z++) {
-				cells.push_back(Cell());
-				auto& cell = cells.back();
-				cell.aabb = { bounds.min + Vec3(x, y, z) * cellsize, bounds.min + Vec3(x + 1, y + 1, z + 1) * cellsize };
-				for (auto& tri: triangles) {
-					auto triaabb = enclose(tri.a.pos, tri.b.pos, tri.c.pos);
-					if (cell.aabb.intersects(triaabb)) {
-						cell.triangles.push_back(tri);
-					}
-				}
-				if (cell.triangles.empty()) cells.pop_back();
-			}
-		}
-	}
+	build(std::move(unique.vertices), std::move(triangles));
 
 	delete buf;
 }
 
-void Mesh::loadObj(const std::string& filename) {
-	/*vertices.clear();
-	indices.clear();
-
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string warn, err;
+// Bounds of the triangles of a mesh, to build or refit its BVH over.
+std::vector<TriangleBounds> triangleBounds(const Mesh& mesh) {
+	std::vector<TriangleBounds> bounds;
+	bounds.reserve(mesh.triangles.size());
+	for (auto& tri : mesh.triangles) {
+		bounds.push_back({ enclose(mesh.vertices[tri.v[0]].pos, mesh.vertices[tri.v[1]].pos, mesh.vertices[tri.v[2]].pos) });
+	}
+	return bounds;
+}
 
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str())) {
-		throw std::runtime_error(warn + err);
+void Mesh::build(std::vector<Vertex> vertices, std::vector<Triangle> triangles) {
+	this->vertices = std::move(vertices);
+	this->triangles = std::move(triangles);
+	for (size_t i = 0; i < this->triangles.size(); i++) {
+		auto& tri = this->triangles[i];
+		tri.id = i;
+		tri.cullBackface = g_materials[tri.material].cullBackfaces;
 	}
+	measure();
+	bvh.build(triangleBounds(*this));
+}
 
-	std::unordered_map<Vertex, uint32_t> uniqueVertices = {};
+void Mesh::refit() {
+	measure();
+	bvh.update(triangleBounds(*this));
+}
 
-	for (const auto& shape : shapes) {
-		for (const auto& index : shape.mesh.indices) {
-			Vertex vertex = {};
+void Mesh::measure() {
+	std::vector<float> areas;
+	areas.reserve(triangles.size());
+	bounds = AABB();
+	for (auto& vertex : vertices) {
+		bounds.enclose(vertex.pos);
+	}
+	for (auto& tri : triangles) {
+		auto& a = vertices[tri.v[0]];
+		auto& b = vertices[tri.v[1]];
+		auto& c = vertices[tri.v[2]];
+		areas.push_back(triangleArea(a.pos, b.pos, c.pos));
+		float uvArea = length(cross(b.uv - a.uv, c.uv - a.uv)) * 0.5f;
+		tri.uvScale = areas.back() > 0 ? sqrtf(uvArea / areas.back()) : 0;
+	}
+	areaDistribution = Distribution1D(areas.data(), areas.size());
+	surfaceArea = areaDistribution.integral * areas.size();
+}
 
-			vertex.pos = {
-				attrib.vertices[3 * index.vertex_index + 0],
-				attrib.vertices[3 * index.vertex_index + 1],
-				attrib.vertices[3 * index.vertex_index + 2]
-			};
+// Maps an MTL material onto the material table, with its diffuse map as the texture.
+MaterialId objMaterial(const tinyobj::material_t& mtl, const std::string& directory) {
+	// Phong exponent to GGX roughness, unless the PBR extension gives one
+	float roughness = mtl.roughness > 0 ? mtl.roughness : sqrtf(2 / (mtl.shininess + 2));
+	Material material(
+		Vec3(mtl.diffuse[0], mtl.diffuse[1], mtl.diffuse[2]),
+		Vec3(mtl.emission[0], mtl.emission[1], mtl.emission[2]),
+		std::min(roughness, 1.0f),
+		mtl.dissolve,
+		mtl.metallic,
+		mtl.ior > 1 ? mtl.ior : 1.5f
+	);
+
+	if (!mtl.diffuse_texname.empty()) {
+		int width, height, channels;
+		auto data = stbi_load((directory + mtl.diffuse_texname).c_str(), &width, &height, &channels, 3);
+		if (data) {
+			std::vector<Vec3> pixels(width * height);
+			for (int i = 0; i < width * height; i++) {
+				pixels[i] = Vec3(data[i * 3], data[i * 3 + 1], data[i * 3 + 2]) / 255;
+			}
+			stbi_image_free(data);
+			return g_materials.addTexture(Texture(width, height, pixels), material);
+		}
+	}
+	return g_materials.add(material);
+}
 
-			vertex.uv = {
-				attrib.texcoords[2 * index.texcoord_index + 0],
-				1.0f - attrib.texcoords[2 * index.texcoord_index + 1],
-				0
-			};
+void Mesh::loadObj(const std::string& filename) {
+	auto obj = readObj(filename);
+
+	auto slash = filename.find_last_of("/\\");
+	auto directory = slash == std::string::npos ? std::string() : filename.substr(0, slash + 1);
+	std::vector<MaterialId> materials;
+	for (auto& mtl : obj.materials) materials.push_back(objMaterial(mtl, directory));
+
+	VertexSet unique;
+	std::vector<uint32_t> indices;
+	indices.reserve(obj.corners.size());
+	unique.indices.reserve(obj.corners.size() / 4);
+	for (auto& corner : obj.corners) {
+		Vertex vertex;
+		vertex.pos = obj.positions[corner.position];
+		vertex.color = obj.colors[corner.position];
+		if (corner.normal >= 0 && length(obj.normals[corner.normal]) > 0) vertex.normal = packNormal(obj.normals[corner.normal]);
+		// obj texture coordinates start at the bottom of the image
+		vertex.uv = corner.texcoord >= 0 ? Vec3(obj.texcoords[corner.texcoord].x, 1 - obj.texcoords[corner.texcoord].y, 0) : Vec3(0, 0, 0);
+
+		indices.push_back(unique.add(vertex));
+	}
 
-			vertex.color = { 1.0f, 1.0f, 1.0f };
+	std::vector<Triangle> triangles;
+	triangles.reserve(indices.size() / 3);
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		int32_t mtl = obj.triangleMaterials[i / 3];
+		triangles.push_back({ { indices[i], indices[i + 1], indices[i + 2] }, mtl >= 0 ? materials[mtl] : material });
+	}
 
-			vertices.push_back(vertex);
+	build(std::move(unique.vertices), std::move(triangles));
+}
 
-			if (uniqueVertices.count(vertex) == 0) {
-				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-				vertices.push_back(vertex);
-			}
+TriangleRay::TriangleRay(const Ray& ray): origin(ray.origin) {
+	auto& d = ray.direction;
+	float ax = fabsf(d.x), ay = fabsf(d.y), az = fabsf(d.z);
+	kz = ax > ay ? (ax > az ? 0 : 2) : (ay > az ? 1 : 2);
+	kx = (kz + 1) % 3;
+	ky = (kx + 1) % 3;
+	// keep the winding of the projected triangle
+	if ((&d.x)[kz] < 0) std::swap(kx, ky);
+	sx = (&d.x)[kx] / (&d.x)[kz];
+	sy = (&d.x)[ky] / (&d.x)[kz];
+	sz = 1.0f / (&d.x)[kz];
+}
 
-			indices.push_back(uniqueVertices[vertex]);
-		}
+bool intersectTriangle(const TriangleRay& ray, const Vec3& p0, const Vec3& p1, const Vec3& p2, float tMin, float tMax, float& t, float& u, float& v, bool cullBackface) {
+	// vertices relative to the origin, sheared into the ray's space by the
+	// same code for each so a vertex lands in the same place in every triangle
+	const Vec3* p[3] = { &p0, &p1, &p2 };
+	float x[3], y[3], z[3];
+	for (int i = 0; i < 3; i++) {
+		auto d = *p[i] - ray.origin;
+		z[i] = (&d.x)[ray.kz];
+		x[i] = (&d.x)[ray.kx] - ray.sx * z[i];
+		y[i] = (&d.x)[ray.ky] - ray.sy * z[i];
 	}
 
-	for (auto& vertex : vertices) {
-		if (vertex.pos.x > bounds.max.x) bounds.max.x = vertex.pos.x;
-		else if (vertex.pos.x < bounds.min.x) bounds.min.x = vertex.pos.x;
-		if (vertex.pos.y > bounds.max.y) bounds.max.y = vertex.pos.y;
-		else if (vertex.pos.y < bounds.min.y) bounds.min.y = vertex.pos.y;
-		if (vertex.pos.z > bounds.max.z) bounds.max.z = vertex.pos.z;
-		else if (vertex.pos.z < bounds.min.z) bounds.min.z = vertex.pos.z;
+	// scaled barycentrics as edge functions. Products of floats are exact in
+	// double, so the two triangles of a shared edge get exactly opposite
+	// values whether or not the compiler fuses multiply and subtract.
+	float e0 = float(double(x[2]) * y[1] - double(y[2]) * x[1]);
+	float e1 = float(double(x[0]) * y[2] - double(y[0]) * x[2]);
+	float e2 = float(double(x[1]) * y[0] - double(y[1]) * x[0]);
+
+	if (cullBackface) {
+		if (e0 < 0 || e1 < 0 || e2 < 0) return false;
 	}
+	else if ((e0 < 0 || e1 < 0 || e2 < 0) && (e0 > 0 || e1 > 0 || e2 > 0)) return false;
+	float det = e0 + e1 + e2;
+	if (det == 0) return false;
+
+	// t scaled by det, compared before the division
+	float scaled = (e0 * z[0] + e1 * z[1] + e2 * z[2]) * ray.sz;
+	float inv = 1.0f / det;
+	t = scaled * inv;
+	if (!(t > tMin && t <= tMax)) return false;
+	u = e1 * inv;
+	v = e2 * inv;
+	return true;
+}
 
-	Vec3 numcells = (bounds.max - bounds.min);
-	numcells.x = 1 + (int)numcells.x;
-	numcells.y = 1 + (int)numcells.y;
-	numcells.z = 1 + (int)numcells.z;
-	Vec3 cellsize = (bounds.max - bounds.min) / numcells;
-	for (int x = 0; x < numcells.x; x++) {
-		for (int y = 0; y < numcells.y; y++) {
-			for (int z = 0; z < numcells.z; z++) {
-				cells.push_back(Cell());
-				auto& cell = cells.back();
-				cell.aabb = { bounds.min + Vec3(x, y, z) * cellsize, bounds.min + Vec3(x + 1, y + 1, z + 1) * cellsize };
-				for (int i = 0; i < indices.size(); i += 3) {
-					auto& a = vertices[indices[i]];
-					auto& b = vertices[indices[i + 1]];
-					auto& c = vertices[indices[i + 2]];
-
-					if (cell.aabb.intersects(enclose(a.pos, b.pos, c.pos))) {
-						cell.triangles.push_back({ a, b, c });
-					}
-				}
-				if (cell.triangles.empty()) cells.pop_back();
-			}
-		}
-	}*/
+void triangleAttributes(const Vertex& v0, const Vertex& v1, const Vertex& v2, float u, float v, Hit* hit) {
+	hit->normal = normalized(cross(v1.pos - v0.pos, v2.pos - v0.pos));
+	hit->uvw = v0.uv + (v1.uv - v0.uv) * u + (v2.uv - v0.uv) * v;
+	if (v0.normal == kNoNormal || v1.normal == kNoNormal || v2.normal == kNoNormal) {
+		hit->shadingNormal = Vec3(0, 0, 0);
+		return;
+	}
+	auto n = unpackNormal(v0.normal) * (1 - u - v) + unpackNormal(v1.normal) * u + unpackNormal(v2.normal) * v;
+	float l = length(n);
+	hit->shadingNormal = l > 0 ? n / l : Vec3(0, 0, 0);
 }
 
 bool rayTriangle(const Ray& ray, const Vertex& v0, const Vertex& v1, const Vertex& v2, Hit* hit) {
-#if true
-	Vec3 edge1, edge2, h, s, q;
-	float a, f, u, v;
-	edge1 = v1.pos - v0.pos;
-	edge2 = v2.pos - v0.pos;
-	h = cross(ray.direction, edge2);
-	a = dot(edge1, h);
-	if (a > -kEpsilon && a < kEpsilon)
-		return false;    // This ray is parallel to this triangle.
-	f = 1.0 / a;
-	s = ray.origin - v0.pos;
-	u = f * dot(s, h);
-	if (u < 0.0 || u > 1.0)
-		return false;
-	q = cross(s, edge1);
-	v = f * dot(ray.direction, q);
-	if (v < 0.0 || u + v > 1.0)
-		return false;
-	// At this stage we can compute t to find out where the intersection point is on the line.
-	float t = f * dot(edge2, q);
-	if (t < kEpsilon)
-		return false;
-
+	float t, u, v;
+	if (!intersectTriangle(TriangleRay(ray), v0.pos, v1.pos, v2.pos, hit ? hit->minDistance : 0, hit ? hit->distance : INFINITY, t, u, v)) return false;
 	if (hit) {
-		if (t > hit->distance || t < hit->minDistance) return false;
 		hit->distance = t;
-		hit->normal = normalized(cross(edge1, edge2));
-		hit->uvw = v0.uv + (v1.uv - v0.uv) * u + (v2.uv - v0.uv) * v;
+		triangleAttributes(v0, v1, v2, u, v, hit);
 	}
-
 	return true;
-#else	
-	// compute plane's normal
-	Vec3 v0v1 = v1.pos - v0.pos;
-	Vec3 v0v2 = v2.pos - v0.pos;
-	// no need to normalize
-	Vec3 N = cross(v0v1, v0v2); // N
-	float area2 = dot(N, N);
-	if (area2 < kEpsilon) return false;
-
-	float ddn = dot(ray.direction, N);
-	float t = dot(v0.pos - ray.origin, N) / ddn;
-	if (t < 0 || (hit && t > hit->distance)) return false;
-
-	Vec3 P = ray.origin + ray.direction * t;
-
-	// Step 2: inside-outside test
-	Vec3 C; // vector perpendicular to triangle's plane
-
-	// edge 0
-	Vec3 vp0 = P - v0.pos;
-	C = cross(v0v1, vp0);
-	if (dot(N, C) < 0) return false; // P is on the right side
-
-	// edge 2
-	Vec3 vp2 = P - v2.pos;
-	C = cross(-v0v2, vp2);
-	if (dot(N, C) < 0) return false; // P is on the right side;
-
-    // edge 1
-	Vec3 edge1 = v2.pos - v1.pos;
-	Vec3 vp1 = P - v1.pos;
-	C = cross(edge1, vp1);
-	if (dot(N, C) < 0) return false; // P is on the right side
+}
 
-	if (hit) {
-		hit->distance = t;
-		hit->normal = N;
-	}
-	return true; // this ray hits the triangle
-#endif
+bool triangleOccludes(const Ray& ray, const Vertex& v0, const Vertex& v1, const Vertex& v2, float tMin, float tMax) {
+	float t, u, v;
+	return intersectTriangle(TriangleRay(ray), v0.pos, v1.pos, v2.pos, tMin, tMax, t, u, v);
 }
 
 float testAABB(const Ray& ray, const AABB& aabb) {
@@ -534,62 +580,83 @@ float testAABB(const Ray& ray, const AABB& aabb) {
 	return tmin;
 }
 
-struct SortedCell {
-	Cell* cell;
-	float t;
-};
-
 bool Mesh::intersect(const Ray& ray, Hit* hit) {
-	static thread_local std::vector<SortedCell> sortedcells;
-
-	float t = testAABB(ray, bounds);
-	if (t < 0 || hit && (t > hit->distance || t < hit->minDistance)) return false;
+	float tMin = hit ? hit->minDistance : kMinDistance;
+	float distance = hit ? hit->distance : INFINITY;
+	int closest = -1;
+	float hitU = 0, hitV = 0;
+	TriangleRay triangleRay(ray);
+	bool isHit = bvh.traverse(ray, tMin, distance, !hit, [&](const IndexBatch& batch, float& limit) {
+		bool found = false;
+		for (int k = 0; k < batch.count; k++) {
+			auto& tri = triangles[batch.index[k]];
+			float t, u, v;
+			if (!intersectTriangle(triangleRay, vertices[tri.v[0]].pos, vertices[tri.v[1]].pos, vertices[tri.v[2]].pos, tMin, limit, t, u, v, tri.cullBackface)) continue;
+			limit = t;
+			closest = batch.index[k];
+			hitU = u;
+			hitV = v;
+			found = true;
+		}
+		return found;
+	});
 
-	bool isHit = false;
-	Hit myHit;
-	if (hit) {
-		myHit.distance = hit->distance;
-		myHit.minDistance = hit->minDistance;
+	// attributes only for the closest hit, not for every nearer one on the way
+	if (hit && isHit) {
+		auto& tri = triangles[closest];
+		hit->distance = distance;
+		hit->material = tri.material;
+		hit->primitive = tri.id;
+		hit->uvScale = tri.uvScale;
+		triangleAttributes(vertices[tri.v[0]], vertices[tri.v[1]], vertices[tri.v[2]], hitU, hitV, hit);
 	}
 
-	sortedcells.clear();
-	for (auto& cell : cells) {
-		float t = kEpsilon;
-		t = testAABB(ray, cell.aabb);
-		if (t < 0 || t > myHit.distance || t < myHit.minDistance) continue;
-		sortedcells.push_back({ &cell, t });
-	}
-	
-	std::sort(sortedcells.begin(), sortedcells.end(), [](const SortedCell& a, const SortedCell& b) {
-		return a.t < b.t;
-	});
+	return isHit;
+}
 
-	for (auto& scell : sortedcells) {
-		auto& cell = *scell.cell;
-		for (auto& tri: cell.triangles) {
-			if (rayTriangle(ray, tri.a, tri.b, tri.c, &myHit)) {
-				myHit.material = tri.material;
-				isHit = true;
-			}
+bool Mesh::occluded(const Ray& ray, float tMax) const {
+	float distance = tMax;
+	TriangleRay triangleRay(ray);
+	return bvh.traverse(ray, kMinDistance, distance, true, [&](const IndexBatch& batch, float& limit) {
+		for (int k = 0; k < batch.count; k++) {
+			auto& tri = triangles[batch.index[k]];
+			float t, u, v;
+			if (intersectTriangle(triangleRay, vertices[tri.v[0]].pos, vertices[tri.v[1]].pos, vertices[tri.v[2]].pos, kMinDistance, limit, t, u, v, tri.cullBackface)) return true;
 		}
+		return false;
+	});
+}
 
-		if (isHit) break;
-	}
+AABB Mesh::getBounds() const {
+	return bounds;
+}
 
-	if (hit && isHit) {
-		if (myHit.distance > hit->distance || myHit.distance < hit->minDistance) return false;
-		*hit = myHit;
-		hit->obj = this;
-		hit->normal = normalized(myHit.normal);
-	}
+float Mesh::getSurfaceArea() {
+	return surfaceArea;
+}
 
-	return isHit;
+SurfaceSample Mesh::sampleSurface(Prng& prng, float time) {
+	if (triangles.empty()) return { Vec3(0, 0, 0), Vec3(0, 1, 0), Vec3(0, 0, 0) };
+
+	// pick a triangle by area
+	float pdf;
+	int i;
+	areaDistribution.sample(prng.frand(0, 1), pdf, &i);
+	auto& tri = triangles[i];
+	return sampleTriangle(vertices[tri.v[0]], vertices[tri.v[1]], vertices[tri.v[2]], prng.frand(0, 1), prng.frand(0, 1));
 }
 
-float Mesh::getSurfaceArea() {
-	return 1;
+float triangleArea(const Vec3& p0, const Vec3& p1, const Vec3& p2) {
+	return length(cross(p1 - p0, p2 - p0)) * 0.5f;
 }
 
-Vec3 Mesh::getRandomPoint(Prng& prng) {
-	return Vec3(0, 0, 0);
+SurfaceSample sampleTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, float u0, float u1) {
+	float su = sqrtf(u0);
+	float b1 = 1 - su;
+	float b2 = u1 * su;
+	return {
+		v0.pos + (v1.pos - v0.pos) * b1 + (v2.pos - v0.pos) * b2,
+		normalized(cross(v1.pos - v0.pos, v2.pos - v0.pos)),
+		v0.uv + (v1.uv - v0.uv) * b1 + (v2.uv - v0.uv) * b2
+	};
 }
@@ -4,56 +4,28 @@
 #include "Object.h"
 #include <string>
 #include "Vec3.h"
+#include "AABB.h"
+#include "Bvh.h"
+#include "Distribution.h"
 #include <map>
 
+// Packed normal of a vertex without one, outside the range packNormal produces.
+const uint32_t kNoNormal = 0x80008000;
+
 struct Vertex {
 	Vec3 pos;
-	Vec3 norm;
+	uint32_t normal = kNoNormal; // shading normal, see packNormal
 	Vec3 color;
 	Vec3 uv;
 };
 
-struct AABB {
-	Vec3 min = Vec3(99999999);
-	Vec3 max = Vec3(-99999999);
-
-	bool intersects(const AABB& other) const {
-		return
-			min.x <= other.max.x
-			&& min.y <= other.max.y
-			&& min.z <= other.max.z
-			&& max.x >= other.min.x
-			&& max.y >= other.min.y
-			&& max.z >= other.min.z;
-	}
-
-	bool contains(const Vec3& p) const {
-		return
-			p.x >= min.x && p.x <= max.x
-			&& p.y >= min.y && p.y <= max.y
-			&& p.z >= min.z && p.z <= max.z;
-	}
-
-	void enclose(const Vec3& p) {
-		if (p.x > max.x) max.x = p.x;
-		if (p.x < min.x) min.x = p.x;
-		if (p.y > max.y) max.y = p.y;
-		if (p.y < min.y) min.y = p.y;
-		if (p.z > max.z) max.z = p.z;
-		if (p.z < min.z) min.z = p.z;
-	}
-};
-
+// Corners are indices into Mesh::vertices, shared with neighbouring triangles.
 struct Triangle {
-	Vertex a;
-	Vertex b;
-	Vertex c;
-	Material* material;
-};
-
-struct Cell {
-	AABB aabb;
-	std::vector<Triangle> triangles;
+	uint32_t v[3];
+	MaterialId material;
+	uint32_t id = 0; // index in Mesh::triangles
+	float uvScale = 0; // uv units per unit of length on the triangle
+	bool cullBackface = false; // from the material, when the triangle is built into a mesh
 };
 
 struct BspLight {
@@ -61,19 +33,63 @@ struct BspLight {
 	float val;
 };
 
+// A ray set up for watertight triangle tests (Woop, Benthin and Wald 2013):
+// its dominant axis becomes z and the other two are sheared so the ray runs
+// along z. Edge tests in that plane classify points on shared edges the same
+// way for both triangles, so rays cannot slip between them.
+struct TriangleRay {
+	TriangleRay(const Ray& ray);
+
+	Vec3 origin;
+	int kx, ky, kz;
+	float sx, sy, sz;
+};
+
+bool rayTriangle(const Ray& ray, const Vertex& v0, const Vertex& v1, const Vertex& v2, Hit* hit);
+// Distance and barycentrics of p1 and p2 where the ray hits the triangle
+// within (tMin, tMax]. With cullBackface only the counter-clockwise side is hit.
+bool intersectTriangle(const TriangleRay& ray, const Vec3& p0, const Vec3& p1, const Vec3& p2, float tMin, float tMax, float& t, float& u, float& v, bool cullBackface = false);
+// Normals and texture coordinates of the hit at barycentrics u and v.
+void triangleAttributes(const Vertex& v0, const Vertex& v1, const Vertex& v2, float u, float v, Hit* hit);
+float testAABB(const Ray& ray, const AABB& aabb);
+// True if the ray hits the triangle within (tMin, tMax), computes nothing else.
+bool triangleOccludes(const Ray& ray, const Vertex& v0, const Vertex& v1, const Vertex& v2, float tMin, float tMax);
+float triangleArea(const Vec3& p0, const Vec3& p1, const Vec3& p2);
+// Maps two uniform numbers to a point distributed uniformly over the triangle.
+SurfaceSample sampleTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, float u0, float u1);
+
 struct Mesh : Object {
+	// Loads a Wavefront .obj file or a Quake 2 .bsp map, by extension.
 	Mesh(const std::string& filename);
-	bool intersect(const Ray& ray, Hit* hit) final override;
-	Vec3 getRandomPoint(Prng& prng) final override;
-	Material* loadWal(const std::string& name, int lightLevel, float opacity);
-	float getSurfaceArea() final override;
+	Mesh(const std::vector<Vertex>& vertices, const std::vector<Triangle>& triangles, MaterialId material);
+	bool intersect(const Ray& ray, Hit* hit);
+	bool occluded(const Ray& ray, float tMax) const;
+	SurfaceSample sampleSurface(Prng& prng, float time = 0);
+	MaterialId loadWal(const std::string& name, int lightLevel, float opacity);
+	float getSurfaceArea();
+	AABB getBounds() const;
 
+	// Throws std::runtime_error if the file cannot be read.
 	void loadObj(const std::string& filename);
 	void loadBsp(const std::string& filename);
+	// Fits the bounds around the triangles and builds the BVH over them.
+	void build(std::vector<Vertex> vertices, std::vector<Triangle> triangles);
+	// Call after moving vertices in place. Refits the BVH,
+	// or rebuilds it if the triangles moved too far apart, see BatchBvh::update.
+	// Instances of the mesh pick up the new bounds in Scene::refit.
+	void refit();
 	AABB bounds;
-	std::vector<Cell> cells;
-	std::map<std::string, Material*> textures;
+	std::vector<Vertex> vertices;
+	std::vector<Triangle> triangles;
+	BatchBvh<IndexBatch> bvh;
+	Distribution1D areaDistribution;
+	float surfaceArea = 0;
+	std::map<std::string, MaterialId> textures;
 	std::vector<BspLight> lights;
+
+private:
+	// Bounds, area distribution and uv scales of the current triangles.
+	void measure();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,366 @@
+#include "ObjFile.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+// Below this a single thread parses the whole file.
+const size_t kMinChunkSize = 1 << 20;
+
+void fail(const std::string& message) {
+	throw std::runtime_error("obj: " + message);
+}
+
+bool isSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool isDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+const char* skipSpace(const char* p, const char* end) {
+	while (p < end && isSpace(*p)) p++;
+	return p;
+}
+
+bool parseInt(const char*& p, const char* end, int& value) {
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+	if (p == end || !isDigit(*p)) return false;
+	int64_t v = 0;
+	while (p < end && isDigit(*p)) {
+		v = v * 10 + (*p++ - '0');
+		if (v > INT32_MAX) return false;
+	}
+	value = negative ? -int(v) : int(v);
+	return true;
+}
+
+// Plain decimal and exponent notation, bounded by end since the mapped file
+// has no terminating zero for strtof.
+bool parseFloat(const char*& p, const char* end, float& value) {
+	static const double powers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	p = skipSpace(p, end);
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+	double mantissa = 0;
+	int exponent = 0;
+	bool digits = false;
+	for (; p < end && isDigit(*p); p++, digits = true) mantissa = mantissa * 10 + (*p - '0');
+	if (p < end && *p == '.') {
+		for (p++; p < end && isDigit(*p); p++, digits = true) {
+			mantissa = mantissa * 10 + (*p - '0');
+			exponent--;
+		}
+	}
+	if (!digits) return false;
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		int e;
+		if (!parseInt(p, end, e)) return false;
+		exponent += e;
+	}
+
+	if (exponent < 0) mantissa = -exponent <= 22 ? mantissa / powers[-exponent] : mantissa * pow(10.0, exponent);
+	else if (exponent > 0) mantissa = exponent <= 22 ? mantissa * powers[exponent] : mantissa * pow(10.0, exponent);
+	value = float(negative ? -mantissa : mantissa);
+	return true;
+}
+
+enum class LineType {
+	Position,
+	Texcoord,
+	Normal,
+	Face,
+	UseMaterial,
+	MaterialLibrary,
+	Other,
+};
+
+// Classifies the line starting at p and moves p past the keyword.
+LineType lineType(const char*& p, const char* end) {
+	p = skipSpace(p, end);
+	const char* word = p;
+	while (p < end && !isSpace(*p) && *p != '\n') p++;
+	size_t length = p - word;
+
+	if (length == 1 && word[0] == 'v') return LineType::Position;
+	if (length == 2 && word[0] == 'v' && word[1] == 't') return LineType::Texcoord;
+	if (length == 2 && word[0] == 'v' && word[1] == 'n') return LineType::Normal;
+	if (length == 1 && word[0] == 'f') return LineType::Face;
+	if (length == 6 && memcmp(word, "usemtl", 6) == 0) return LineType::UseMaterial;
+	if (length == 6 && memcmp(word, "mtllib", 6) == 0) return LineType::MaterialLibrary;
+	return LineType::Other;
+}
+
+std::string restOfLine(const char* p, const char* end) {
+	p = skipSpace(p, end);
+	while (end > p && isSpace(end[-1])) end--;
+	return std::string(p, end);
+}
+
+struct Chunk {
+	const char* begin;
+	const char* end;
+
+	// attributes before the chunk, from the counting pass
+	int32_t positionBase = 0;
+	int32_t texcoordBase = 0;
+	int32_t normalBase = 0;
+	int32_t positionCount = 0;
+	int32_t texcoordCount = 0;
+	int32_t normalCount = 0;
+
+	std::vector<Vec3> positions;
+	std::vector<Vec3> colors;
+	std::vector<Vec3> texcoords;
+	std::vector<Vec3> normals;
+	std::vector<ObjCorner> corners;
+	// per triangle into materialNames, -1 until the chunk's first usemtl
+	std::vector<int32_t> materials;
+	std::vector<std::string> materialNames;
+	int32_t lastMaterial = -1; // in use at the end of the chunk
+	std::vector<std::string> libraries;
+	std::exception_ptr error;
+};
+
+template<typename F>
+void forEachLine(const Chunk& chunk, F&& f) {
+	const char* p = chunk.begin;
+	while (p < chunk.end) {
+		auto newline = (const char*)memchr(p, '\n', chunk.end - p);
+		const char* lineEnd = newline ? newline : chunk.end;
+		f(p, lineEnd);
+		p = lineEnd + 1;
+	}
+}
+
+void countChunk(Chunk& chunk) {
+	forEachLine(chunk, [&](const char* p, const char* end) {
+		switch (lineType(p, end)) {
+		case LineType::Position: chunk.positionCount++; break;
+		case LineType::Texcoord: chunk.texcoordCount++; break;
+		case LineType::Normal: chunk.normalCount++; break;
+		default: break;
+		}
+	});
+}
+
+// Turns a 1-based or negative relative index into a 0-based one.
+int32_t resolveIndex(int index, int32_t seen, int32_t total) {
+	int32_t resolved = index > 0 ? index - 1 : seen + index;
+	if (index == 0 || resolved < 0 || resolved >= total) fail("index " + std::to_string(index) + " out of range");
+	return resolved;
+}
+
+void parseChunk(Chunk& chunk, int32_t totalPositions, int32_t totalTexcoords, int32_t totalNormals) {
+	chunk.positions.reserve(chunk.positionCount);
+	chunk.colors.reserve(chunk.positionCount);
+	chunk.texcoords.reserve(chunk.texcoordCount);
+	chunk.normals.reserve(chunk.normalCount);
+	int32_t material = -1;
+	std::vector<ObjCorner> face;
+
+	forEachLine(chunk, [&](const char* p, const char* end) {
+		switch (lineType(p, end)) {
+		case LineType::Position: {
+			float v[6] = { 0, 0, 0, 1, 1, 1 };
+			int n = 0;
+			while (n < 6 && parseFloat(p, end, v[n])) n++;
+			if (n < 3) fail("bad vertex");
+			chunk.positions.push_back(Vec3(v[0], v[1], v[2]));
+			// x y z r g b, while a fourth value alone is a weight
+			chunk.colors.push_back(n == 6 ? Vec3(v[3], v[4], v[5]) : Vec3(1, 1, 1));
+			break;
+		}
+		case LineType::Texcoord: {
+			float v[2] = { 0, 0 };
+			if (!parseFloat(p, end, v[0])) fail("bad texture coordinate");
+			parseFloat(p, end, v[1]);
+			chunk.texcoords.push_back(Vec3(v[0], v[1], 0));
+			break;
+		}
+		case LineType::Normal: {
+			float v[3];
+			for (int i = 0; i < 3; i++) {
+				if (!parseFloat(p, end, v[i])) fail("bad normal");
+			}
+			chunk.normals.push_back(Vec3(v[0], v[1], v[2]));
+			break;
+		}
+		case LineType::Face: {
+			int32_t seenPositions = chunk.positionBase + chunk.positions.size();
+			int32_t seenTexcoords = chunk.texcoordBase + chunk.texcoords.size();
+			int32_t seenNormals = chunk.normalBase + chunk.normals.size();
+			face.clear();
+			for (p = skipSpace(p, end); p < end; p = skipSpace(p, end)) {
+				// v, v/vt, v//vn or v/vt/vn
+				ObjCorner corner = { 0, -1, -1 };
+				int index;
+				if (!parseInt(p, end, index)) fail("bad face");
+				corner.position = resolveIndex(index, seenPositions, totalPositions);
+				if (p < end && *p == '/') {
+					p++;
+					if (p < end && *p != '/') {
+						if (!parseInt(p, end, index)) fail("bad face");
+						corner.texcoord = resolveIndex(index, seenTexcoords, totalTexcoords);
+					}
+					if (p < end && *p == '/') {
+						p++;
+						if (!parseInt(p, end, index)) fail("bad face");
+						corner.normal = resolveIndex(index, seenNormals, totalNormals);
+					}
+				}
+				face.push_back(corner);
+			}
+			for (size_t i = 2; i < face.size(); i++) {
+				chunk.corners.push_back(face[0]);
+				chunk.corners.push_back(face[i - 1]);
+				chunk.corners.push_back(face[i]);
+				chunk.materials.push_back(material);
+			}
+			break;
+		}
+		case LineType::UseMaterial: {
+			auto name = restOfLine(p, end);
+			auto it = std::find(chunk.materialNames.begin(), chunk.materialNames.end(), name);
+			material = it - chunk.materialNames.begin();
+			if (it == chunk.materialNames.end()) chunk.materialNames.push_back(name);
+			break;
+		}
+		case LineType::MaterialLibrary:
+			chunk.libraries.push_back(restOfLine(p, end));
+			break;
+		default:
+			break;
+		}
+	});
+	chunk.lastMaterial = material;
+}
+
+// Runs f on every chunk on its own thread and rethrows the first error.
+template<typename F>
+void parallel(std::vector<Chunk>& chunks, F&& f) {
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < chunks.size(); i++) {
+		threads.emplace_back([&, i]() {
+			try {
+				f(chunks[i]);
+			}
+			catch (...) {
+				chunks[i].error = std::current_exception();
+			}
+		});
+	}
+	try {
+		f(chunks[0]);
+	}
+	catch (...) {
+		chunks[0].error = std::current_exception();
+	}
+	for (auto& thread : threads) thread.join();
+	for (auto& chunk : chunks) {
+		if (chunk.error) std::rethrow_exception(chunk.error);
+	}
+}
+
+template<typename T>
+void append(std::vector<T>& to, const std::vector<T>& from) {
+	to.insert(to.end(), from.begin(), from.end());
+}
+
+}
+
+ObjFile readObj(const std::string& filename) {
+	MappedFile file;
+	if (!file.open(filename)) fail("cannot open " + filename);
+	auto data = (const char*)file.data();
+	auto end = data + file.size();
+
+	// split at line ends into one chunk per thread
+	int threads = std::max(1, std::min((int)std::thread::hardware_concurrency(), int(file.size() / kMinChunkSize)));
+	std::vector<Chunk> chunks(threads);
+	const char* p = data;
+	for (int i = 0; i < threads; i++) {
+		const char* split = i + 1 < threads ? data + file.size() * (i + 1) / threads : end;
+		if (split < p) split = p;
+		auto newline = split < end ? (const char*)memchr(split, '\n', end - split) : nullptr;
+		chunks[i].begin = p;
+		chunks[i].end = i + 1 < threads && newline ? newline + 1 : end;
+		p = chunks[i].end;
+	}
+
+	parallel(chunks, countChunk);
+	int64_t positions = 0, texcoords = 0, normals = 0;
+	for (auto& chunk : chunks) {
+		chunk.positionBase = positions;
+		chunk.texcoordBase = texcoords;
+		chunk.normalBase = normals;
+		positions += chunk.positionCount;
+		texcoords += chunk.texcoordCount;
+		normals += chunk.normalCount;
+	}
+	if (positions > INT32_MAX || texcoords > INT32_MAX || normals > INT32_MAX) fail("too many vertices");
+	parallel(chunks, [&](Chunk& chunk) { parseChunk(chunk, positions, texcoords, normals); });
+
+	ObjFile obj;
+	obj.positions.reserve(positions);
+	obj.colors.reserve(positions);
+	obj.texcoords.reserve(texcoords);
+	obj.normals.reserve(normals);
+	size_t corners = 0;
+	for (auto& chunk : chunks) corners += chunk.corners.size();
+	obj.corners.reserve(corners);
+	obj.triangleMaterials.reserve(corners / 3);
+
+	// material libraries, relative to the directory of the file
+	auto slash = filename.find_last_of("/\\");
+	auto directory = slash == std::string::npos ? std::string() : filename.substr(0, slash + 1);
+	std::map<std::string, int> materialIds;
+	for (auto& chunk : chunks) {
+		for (auto& library : chunk.libraries) {
+			std::ifstream mtl(directory + library);
+			if (!mtl.good()) continue;
+			std::string warning, error;
+			tinyobj::LoadMtl(&materialIds, &obj.materials, &mtl, &warning, &error);
+		}
+	}
+
+	// the material in use carries over from one chunk into the next
+	int32_t material = -1;
+	for (auto& chunk : chunks) {
+		append(obj.positions, chunk.positions);
+		append(obj.colors, chunk.colors);
+		append(obj.texcoords, chunk.texcoords);
+		append(obj.normals, chunk.normals);
+		append(obj.corners, chunk.corners);
+
+		std::vector<int32_t> ids;
+		for (auto& name : chunk.materialNames) {
+			auto it = materialIds.find(name);
+			ids.push_back(it != materialIds.end() ? it->second : -1);
+		}
+		for (auto local : chunk.materials) {
+			if (local >= 0) material = ids[local];
+			obj.triangleMaterials.push_back(material);
+		}
+		if (chunk.lastMaterial >= 0) material = ids[chunk.lastMaterial];
+	}
+
+	return obj;
+}
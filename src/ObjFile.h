@@ -0,0 +1,34 @@
+#ifndef ObjFile_h
+#define ObjFile_h
+
+#include "Vec3.h"
+#include "tiny_obj_loader.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One vertex of a face, as indices into the attribute arrays, -1 when absent.
+struct ObjCorner {
+	int32_t position;
+	int32_t texcoord;
+	int32_t normal;
+};
+
+// Geometry of a Wavefront .obj file with its faces fanned into triangles.
+struct ObjFile {
+	std::vector<Vec3> positions;
+	std::vector<Vec3> colors; // per position, white unless the file has vertex colors
+	std::vector<Vec3> texcoords;
+	std::vector<Vec3> normals;
+	std::vector<ObjCorner> corners; // three per triangle
+	std::vector<int32_t> triangleMaterials; // index into materials, -1 for none
+	std::vector<tinyobj::material_t> materials; // from the mtllib files
+};
+
+// Parses the file in chunks on several threads: a first pass counts the
+// attributes of each chunk so the second can resolve relative indices on its own.
+// Throws std::runtime_error on missing files and malformed data.
+ObjFile readObj(const std::string& filename);
+
+#endif
@@ -5,13 +5,21 @@
 #include "Hit.h"
 #include "Prng.h"
 
-struct Object {
-	virtual bool intersect(const Ray& ray, Hit* hit) = 0;
-	virtual Vec3 getRandomPoint(Prng& prng) = 0;
-	virtual float getSurfaceArea() = 0;
+#include <cstdint>
+
+// A point sampled uniformly by area on a primitive's surface.
+struct SurfaceSample {
+	Vec3 position;
+	Vec3 normal;
+	Vec3 uvw;
+};
 
+// Common data of all primitives. Primitives are plain structs stored by
+// value in the scene's per-type arrays and are never called virtually.
+struct Object {
 	bool isLight = false;
-	Material* material = nullptr;
+	int32_t light = -1; // index into the scene's lights
+	MaterialId material = 0;
 };
 
 #endif
@@ -0,0 +1,35 @@
+#ifndef ObjectRef_h
+#define ObjectRef_h
+
+#include <cstdint>
+
+enum class ObjectType : uint8_t {
+	None,
+	Sphere,
+	Quad,
+	Cube,
+	Plane,
+	Instance,
+	Triangle,
+};
+
+// Handle to an object stored in one of the scene's per-type arrays.
+struct ObjectRef {
+	ObjectType type = ObjectType::None;
+	uint32_t index = 0;
+
+	ObjectRef() = default;
+	ObjectRef(ObjectType type, uint32_t index): type(type), index(index) {}
+
+	explicit operator bool() const { return type != ObjectType::None; }
+};
+
+inline bool operator==(const ObjectRef& a, const ObjectRef& b) {
+	return a.type == b.type && a.index == b.index;
+}
+
+inline bool operator!=(const ObjectRef& a, const ObjectRef& b) {
+	return !(a == b);
+}
+
+#endif
@@ -13,16 +13,25 @@ bool Plane::intersect(const Ray& ray, Hit* hit) {
 
 		hit->distance = dist;
 		hit->material = material;
-		hit->obj = this;
 		hit->normal = normal;
 	}
     return true;
 }
 
-Vec3 Plane::getRandomPoint(Prng& prng) {
-	return Vec3(0,0,0);
+bool Plane::occluded(const Ray& ray, float tMax) const {
+	float dist = dot(origin - ray.origin, normal) / dot(ray.direction, normal);
+	return dist > kMinDistance && dist < tMax;
+}
+
+SurfaceSample Plane::sampleSurface(Prng& prng, float time) {
+	return { origin, normal, Vec3(0, 0, 0) };
 }
 
 float Plane::getSurfaceArea() {
 	return 9999999999999;
-}
\ No newline at end of file
+}
+
+AABB Plane::getBounds() const {
+	// unbounded
+	return AABB{ Vec3(-99999999), Vec3(99999999) };
+}
@@ -4,15 +4,18 @@
 #include "Vec3.h"
 #include "Material.h"
 #include "Object.h"
+#include "AABB.h"
 
 struct Plane: Object {
     Vec3 origin;
     Vec3 normal;
 
-    Plane(const Vec3& origin, const Vec3& normal, Material* material): origin(origin), normal(normal) { this->material = material; }
-    bool intersect(const Ray& ray, Hit* hit) final override;
-	Vec3 getRandomPoint(Prng& prng) final override;
-	float getSurfaceArea() final override;
+    Plane(const Vec3& origin, const Vec3& normal, MaterialId material): origin(origin), normal(normal) { this->material = material; }
+    bool intersect(const Ray& ray, Hit* hit);
+	bool occluded(const Ray& ray, float tMax) const;
+	SurfaceSample sampleSurface(Prng& prng, float time = 0);
+	float getSurfaceArea();
+	AABB getBounds() const;
 };
 
 #endif
\ No newline at end of file
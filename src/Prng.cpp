@@ -1,17 +1,42 @@
 #include "Prng.h"
 
+#include <cmath>
 #include <cstdlib>
 
-Prng::Prng(unsigned int seed): m_seed(seed), rng(seed) {
+namespace {
+
+// splitmix64 finalizer, so neighbouring seeds and sequences start far apart
+uint64_t mix(uint64_t x) {
+	x += 0x9e3779b97f4a7c15ull;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
+
+}
+
+Prng::Prng(uint64_t seed, uint64_t sequence) {
+	this->seed(seed, sequence);
+}
+
+void Prng::seed(uint64_t sd, uint64_t sequence) {
+	state = 0;
+	increment = (mix(sequence) << 1) | 1;
+	next();
+	state += mix(sd);
+	next();
 }
 
-void Prng::seed(unsigned int sd) {
-	m_seed = sd;
-	rng.seed(sd);
+uint32_t Prng::next() {
+	uint64_t old = state;
+	state = old * 6364136223846793005ull + increment;
+	uint32_t shifted = uint32_t(((old >> 18) ^ old) >> 27);
+	uint32_t rot = uint32_t(old >> 59);
+	return (shifted >> rot) | (shifted << ((32 - rot) & 31));
 }
 
 float Prng::frand(float min, float max) {
-	float r = (float)rng() / rng.max();
+	float r = (float)next() / 4294967295.0f;
 	return min * (1.0f - r) + max * r;
 }
 
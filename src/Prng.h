@@ -3,12 +3,14 @@
 
 #include "Vec3.h"
 
-#include <random>
+#include <cstdint>
 
+// PCG32 generator. Seeding is two words of state, so a fresh generator per
+// pixel and sample is cheap; every sequence of a seed is its own stream.
 class Prng {
 public:
-	Prng(unsigned int seed);
-	void seed(unsigned int sd);
+	Prng(uint64_t seed, uint64_t sequence = 0);
+	void seed(uint64_t sd, uint64_t sequence = 0);
 
 	float frand(float min, float max);
 	Vec3 randomPointOnUnitSpherePatch(float tmin, float tmax, float pmin, float pmax);
@@ -20,9 +22,10 @@ public:
 	Vec3 randomPointInUnitCube();
 
 private:
-	std::vector<float> values;
-	std::mt19937 rng;
-	unsigned int m_seed;
+	uint32_t next();
+
+	uint64_t state;
+	uint64_t increment;
 };
 
 #endif
@@ -30,18 +30,47 @@ bool Quad::intersect(const Ray& ray, Hit* hit) {
 	if (hit) {
 		if (t > hit->distance || t < hit->minDistance) return false;
 		hit->distance = t;
-		hit->normal = normalized(cross(edge1, edge2));
+		hit->normal = getNormal(ray.origin + ray.direction * t);
 		hit->material = material;
-		hit->obj = this;
 	}
 
 	return true;
 }
 
-Vec3 Quad::getRandomPoint(Prng& prng) {
-	return origin + u * prng.frand(0, 1) + v * prng.frand(0, 1);
+bool Quad::occluded(const Ray& ray, float tMax) const {
+	auto h = cross(ray.direction, v);
+	float a = dot(u, h);
+	if (a > -kEpsilon && a < kEpsilon) return false;
+	float f = 1.0f / a;
+	auto s = ray.origin - origin;
+	float su = f * dot(s, h);
+	if (su < 0 || su > 1) return false;
+	auto q = cross(s, u);
+	float sv = f * dot(ray.direction, q);
+	if (sv < 0 || sv > 1) return false;
+	float t = f * dot(v, q);
+	return t > kMinDistance && t < tMax;
+}
+
+SurfaceSample Quad::sampleSurface(Prng& prng, float time) {
+	float s = prng.frand(0, 1);
+	float t = prng.frand(0, 1);
+	return { origin + u * s + v * t, getNormal(origin), Vec3(s, t, 0) };
 }
 
 float Quad::getSurfaceArea() {
 	return length(cross(u, v));
+}
+
+Vec3 Quad::getNormal(const Vec3& pos) const {
+	return normalized(cross(u, v));
+}
+
+AABB Quad::getBounds() const {
+	AABB aabb;
+	aabb.enclose(origin);
+	aabb.enclose(origin + u);
+	aabb.enclose(origin + v);
+	aabb.enclose(origin + u + v);
+	return aabb;
 }
\ No newline at end of file
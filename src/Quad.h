@@ -3,18 +3,22 @@
 
 #include "Vec3.h"
 #include "Material.h"
-#include "Object.h"
+#include "Object.h"
+#include "AABB.h"
 
 struct Quad : Object {
 	Vec3 origin;
 	Vec3 u;
 	Vec3 v;
 
-	Quad(const Vec3& origin, const Vec3& u, const Vec3& v, Material* material) : origin(origin), u(u), v(v) { this->material = material; }
+	Quad(const Vec3& origin, const Vec3& u, const Vec3& v, MaterialId material) : origin(origin), u(u), v(v) { this->material = material; }
 
-	bool intersect(const Ray& ray, Hit* hit) final override;
-	Vec3 getRandomPoint(Prng& prng) final override;
-	float getSurfaceArea() final override;
+	bool intersect(const Ray& ray, Hit* hit);
+	bool occluded(const Ray& ray, float tMax) const;
+	SurfaceSample sampleSurface(Prng& prng, float time = 0);
+	float getSurfaceArea();
+	Vec3 getNormal(const Vec3& pos) const;
+	AABB getBounds() const;
 };
 
 #endif
\ No newline at end of file
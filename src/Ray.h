@@ -3,11 +3,46 @@
 
 #include "Vec3.h"
 
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
 struct Ray {
     Vec3 origin;
     Vec3 direction;
+    // Point in the shutter interval, 0 when it opens and 1 when it closes.
+    // Moving objects are intersected where they are at this time.
+    float time;
 
-    Ray(const Vec3& origin, const Vec3& direction): origin(origin), direction(direction) {}
+    Ray(const Vec3& origin, const Vec3& direction, float time = 0): origin(origin), direction(direction), time(time) {}
 };
 
+// Moves a surface point off the surface to the side of direction w, by a
+// number of float ulps of each coordinate rather than a fixed distance, so
+// rays spawned there neither hit the surface again nor skip nearby geometry.
+// n is the geometric normal. After Waechter and Binder, Ray Tracing Gems ch. 6.
+inline Vec3 offsetRayOrigin(const Vec3& p, const Vec3& n, const Vec3& w) {
+	const float kOrigin = 1.0f / 32;
+	const float kFloatScale = 1.0f / 65536;
+	const float kIntScale = 256;
+
+	Vec3 offset = dot(n, w) < 0 ? -n : n;
+	Vec3 result;
+	for (int i = 0; i < 3; i++) {
+		float pi = (&p.x)[i];
+		float ni = (&offset.x)[i];
+		// near the origin ulps get too small, there a fixed offset is safe
+		if (fabsf(pi) < kOrigin) {
+			(&result.x)[i] = pi + kFloatScale * ni;
+			continue;
+		}
+		int32_t bits;
+		memcpy(&bits, &pi, sizeof(bits));
+		int32_t ulps = int32_t(kIntScale * ni);
+		bits += pi < 0 ? -ulps : ulps;
+		memcpy(&(&result.x)[i], &bits, sizeof(bits));
+	}
+	return result;
+}
+
 #endif
\ No newline at end of file
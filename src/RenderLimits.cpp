@@ -0,0 +1,84 @@
+#include "RenderLimits.h"
+#include "Tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+extern long long thread_num_rays[];
+
+namespace {
+
+long long raysSoFar() {
+	long long rays = 0;
+	for (int i = 0; i < numThreads; i++) rays += thread_num_rays[i];
+	return rays;
+}
+
+const char* reasonName(StopReason reason) {
+	switch (reason) {
+	case StopReason::Samples: return "reached spp";
+	case StopReason::Noise: return "reached noise threshold";
+	case StopReason::Time: return "reached time budget";
+	}
+	return "";
+}
+
+}
+
+bool RenderLimits::any() const {
+	return seconds > 0 || spp > 0 || noise > 0;
+}
+
+double RenderStats::raysPerSecond() const {
+	return seconds > 0 ? rays / seconds : 0;
+}
+
+double RenderStats::secondsPerSample() const {
+	return samples > 0 ? seconds / samples : 0;
+}
+
+RenderStats renderUntil(Tracer& tracer, const RenderLimits& limits, const std::function<void()>& afterSample) {
+	typedef std::chrono::steady_clock Clock;
+	auto start = Clock::now();
+	long long startRays = raysSoFar();
+	double slowest = 0;
+
+	RenderStats stats;
+	for (;;) {
+		if (limits.spp > 0 && tracer.numSamples >= limits.spp) {
+			stats.reason = StopReason::Samples;
+			break;
+		}
+		if (limits.noise > 0 && tracer.noise() <= limits.noise) {
+			stats.reason = StopReason::Noise;
+			break;
+		}
+		double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		if (limits.seconds > 0 && stats.samples > 0 && elapsed + slowest > limits.seconds) {
+			stats.reason = StopReason::Time;
+			break;
+		}
+
+		auto before = Clock::now();
+		tracer.sample();
+		slowest = std::max(slowest, std::chrono::duration<double>(Clock::now() - before).count());
+		stats.samples++;
+		if (afterSample) afterSample();
+	}
+
+	stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	stats.rays = raysSoFar() - startRays;
+	stats.noise = tracer.noise();
+	return stats;
+}
+
+std::string describe(const RenderStats& stats) {
+	char noise[32] = "unknown";
+	if (std::isfinite(stats.noise)) snprintf(noise, sizeof(noise), "%.2f%%", stats.noise * 100);
+	char line[256];
+	snprintf(line, sizeof(line), "%d samples in %.2fs, %.2f Mrays/s, %.1f ms/sample, noise %s, %s",
+		stats.samples, stats.seconds, stats.raysPerSecond() / 1e6, stats.secondsPerSample() * 1000, noise, reasonName(stats.reason));
+	return line;
+}
@@ -0,0 +1,46 @@
+#ifndef RenderLimits_h
+#define RenderLimits_h
+
+#include <functional>
+#include <string>
+
+class Tracer;
+
+// When to stop sampling a frame, at the first limit reached. Zero disables
+// a limit.
+struct RenderLimits {
+	double seconds = 0; // wall clock budget of one call to renderUntil
+	int spp = 0;        // samples per pixel in the buffer, resumed ones included
+	float noise = 0;    // relative standard error, see Tracer::noise
+
+	bool any() const;
+};
+
+enum class StopReason {
+	Samples,
+	Noise,
+	Time,
+};
+
+// What one call to renderUntil did.
+struct RenderStats {
+	int samples = 0; // taken by this call
+	double seconds = 0;
+	long long rays = 0;
+	float noise = 0; // of the whole buffer at the end
+	StopReason reason = StopReason::Samples;
+
+	double raysPerSecond() const;
+	double secondsPerSample() const;
+};
+
+// Samples the tracer until a limit is reached, or forever without limits.
+// The time budget is a hard cap: a sample is only started if the slowest so
+// far would still finish within it, except the first since an image needs
+// one. afterSample runs after every sample, e.g. to save checkpoints.
+RenderStats renderUntil(Tracer& tracer, const RenderLimits& limits, const std::function<void()>& afterSample = nullptr);
+
+// One line like "64 samples in 12.30s, 4.52 Mrays/s, 192.2 ms/sample, noise 1.20%, reached spp".
+std::string describe(const RenderStats& stats);
+
+#endif
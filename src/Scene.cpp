@@ -13,47 +13,188 @@
 
 #include <cmath>
 #include <fstream>
-#include <Windows.h>
+#include <ctime>
+#include <algorithm>
+#include <limits>
 
 float frand() {
 	return (float)rand() / RAND_MAX;
 }
 
 Scene::Scene() {
-	srand(GetTickCount());
+	srand(time(nullptr));
 
 	const auto white = Vec3(0.9, 0.9, 0.9);
 	const auto red = Vec3(0.9, 0.2, 0.2);
 	const auto green = Vec3(0.2, 0.9, 0.2);
 	const auto blue = Vec3(0.2, 0.2, 0.9);
 
-	objects.push_back(new Quad(Vec3(-1, -1, -1), Vec3(0, 2, 0), Vec3(0, 0, 2), new DefaultMaterial(red)));
-	objects.push_back(new Quad(Vec3(1, -1, -1), Vec3(0, 2, 0), Vec3(0, 0, 2), new DefaultMaterial(green)));
-	objects.push_back(new Quad(Vec3(-1,  1, -1), Vec3(2, 0, 0), Vec3(0, 0, 2), new DefaultMaterial(white)));
-	objects.push_back(new Quad(Vec3(-1, -1, -1), Vec3(2, 0, 0), Vec3(0, 0, 2), new DefaultMaterial(white)));
-	objects.push_back(new Quad(Vec3(-1, -1,  1), Vec3(2, 0, 0), Vec3(0, 2, 0), new DefaultMaterial(white)));
+	add(Quad(Vec3(-1, -1, -1), Vec3(0, 2, 0), Vec3(0, 0, 2), g_materials.add(Material(red))));
+	add(Quad(Vec3(1, -1, -1), Vec3(0, 2, 0), Vec3(0, 0, 2), g_materials.add(Material(green))));
+	add(Quad(Vec3(-1,  1, -1), Vec3(2, 0, 0), Vec3(0, 0, 2), g_materials.add(Material(white))));
+	add(Quad(Vec3(-1, -1, -1), Vec3(2, 0, 0), Vec3(0, 0, 2), g_materials.add(Material(white))));
+	add(Quad(Vec3(-1, -1,  1), Vec3(2, 0, 0), Vec3(0, 2, 0), g_materials.add(Material(white))));
 
-	auto light = new Quad(Vec3(0, 0.99999, -0.5), Vec3(0.5, 0, 0), Vec3(0, 0, 0.5), new DefaultMaterial(white, white * 10));
-	objects.push_back(light);
+	auto light = add(Quad(Vec3(0, 0.99999, -0.5), Vec3(0.5, 0, 0), Vec3(0, 0, 0.5), g_materials.add(Material(white, white * 10))));
 	addLight(light);
 
-	auto barrier = new Quad(Vec3(-0.2, -0.5, -1), Vec3(0, 1.5, 0), Vec3(0, 0, 2), new DefaultMaterial(white));
-	objects.push_back(barrier);
+	// barrier
+	add(Quad(Vec3(-0.2, -0.5, -1), Vec3(0, 1.5, 0), Vec3(0, 0, 2), g_materials.add(Material(white))));
 
-	auto mirror = new Quad(Vec3(0, -1, -0.5), Vec3(0.7, 0.7, 0), Vec3(-0.5, 0, 1), new DefaultMaterial(white, 0, 0, 1.0f, 1.0f));
-	objects.push_back(mirror);
+	// mirror
+	add(Quad(Vec3(0, -1, -0.5), Vec3(0.7, 0.7, 0), Vec3(-0.5, 0, 1), g_materials.add(Material(white, 0, 0, 1.0f, 1.0f))));
 
-	auto sun = new Sphere(Vec3(0, 1000, 0), 50, new DefaultMaterial(Vec3(0, 0, 0), Vec3(1, 1, 0.7) * 200));
-	objects.push_back(sun);
+	auto sun = add(Sphere(Vec3(0, 1000, 0), 50, g_materials.add(Material(Vec3(0, 0, 0), Vec3(1, 1, 0.7) * 200))));
 	addLight(sun);
 	
-	sunDir = normalized(-sun->center);
+	sunDir = normalized(-spheres[sun.index].center);
 	sunColor = Vec3(1, 1, 0.8);
 }
 
+ObjectRef Scene::add(const Sphere& sphere) {
+	spheres.push_back(sphere);
+	dirty = true;
+	return ObjectRef(ObjectType::Sphere, spheres.size() - 1);
+}
+
+ObjectRef Scene::add(const Quad& quad) {
+	quads.push_back(quad);
+	dirty = true;
+	return ObjectRef(ObjectType::Quad, quads.size() - 1);
+}
+
+ObjectRef Scene::add(const Cube& cube) {
+	cubes.push_back(cube);
+	return ObjectRef(ObjectType::Cube, cubes.size() - 1);
+}
+
+ObjectRef Scene::add(const Plane& plane) {
+	planes.push_back(plane);
+	return ObjectRef(ObjectType::Plane, planes.size() - 1);
+}
+
+ObjectRef Scene::add(const Instance& instance) {
+	instances.push_back(instance);
+	dirty = true;
+	auto ref = ObjectRef(ObjectType::Instance, instances.size() - 1);
+	addMeshLights(ref);
+	return ref;
+}
+
+ObjectRef Scene::add(Mesh* mesh) {
+	return add(Instance(mesh, Transform()));
+}
+
+// Places a mesh light where its instance is, moving along with it.
+void placeLight(TriangleLight& light, const Instance& instance) {
+	light.toWorld = instance.toWorld;
+	light.toWorldEnd = instance.toWorldEnd;
+	light.moving = instance.moving;
+}
+
+// Registers every emissive triangle of an instance as an area light.
+void Scene::addMeshLights(ObjectRef ref) {
+	auto& instance = instances[ref.index];
+	for (auto& tri : instance.mesh->triangles) {
+		if (!g_materials[tri.material].isEmissive()) continue;
+
+		triangleLights.push_back(TriangleLight(instance.mesh, tri.id));
+		placeLight(triangleLights.back(), instance);
+		addLight(ObjectRef(ObjectType::Triangle, triangleLights.size() - 1));
+
+		// lets hits on the instance find the light they came from
+		instance.triangleLights.resize(instance.mesh->triangles.size(), -1);
+		instance.triangleLights[tri.id] = lights.size() - 1;
+		instance.isLight = true;
+	}
+}
+
+void Scene::clear() {
+	spheres.clear();
+	quads.clear();
+	cubes.clear();
+	planes.clear();
+	instances.clear();
+	triangleLights.clear();
+	lights.clear();
+	envMap = nullptr;
+	dirty = true;
+}
+
+void Scene::build() {
+	if (!dirty) return;
+	sphereBvh.build(spheres);
+	quadBvh.build(quads);
+	instanceBvh.build(instances);
+	buildLights();
+	findMotion();
+	dirty = false;
+}
+
+void Scene::refit() {
+	if (dirty) {
+		build();
+		return;
+	}
+	sphereBvh.update(spheres);
+	quadBvh.update(quads);
+	instanceBvh.update(instances);
+
+	// emissive mesh triangles follow their instance
+	for (auto& instance : instances) {
+		for (size_t i = 0; i < instance.triangleLights.size(); i++) {
+			if (instance.triangleLights[i] < 0) continue;
+			placeLight(triangleLights[lights[instance.triangleLights[i]].index], instance);
+		}
+	}
+	buildLights();
+	findMotion();
+}
+
+void Scene::findMotion() {
+	moving = false;
+	for (auto& sphere : spheres) moving |= !(sphere.motion == Vec3(0, 0, 0));
+	for (auto& instance : instances) moving |= instance.moving;
+}
+
+void Scene::buildLights() {
+	std::vector<AABB> bounds;
+	std::vector<float> power;
+	bounds.reserve(lights.size());
+	power.reserve(lights.size());
+	float total = 0;
+	for (auto l : lights) {
+		auto b = visit(l, [](auto& o) { return o.getBounds(); });
+		float area = visit(l, [](auto& o) { return o.getSurfaceArea(); });
+		auto emission = g_materials.evaluate(object(l).material, b.center(), Vec3(0, 0, 0)).emission;
+		bounds.push_back(b);
+		power.push_back(luminance(emission) * area);
+		total += power.back();
+	}
+
+	// a light that looks black at its center may still emit elsewhere, keep it sampleable
+	for (auto& p : power) p = std::max(p, total * 1e-4f / lights.size());
+
+	lightTable = AliasTable(power.data(), power.size());
+	lightBvh.build(bounds, power);
+}
+
+int Scene::pickLight(const Vec3& pos, Prng& prng, float& pmf) {
+	float u = prng.frand(0, 1);
+	if (lightSelection == LightSelection::Spatial) return lightBvh.sample(pos, u, pmf);
+	return lightTable.sample(u, pmf);
+}
+
+float Scene::lightPmf(const Vec3& pos, int light) {
+	if (lightSelection == LightSelection::Spatial) return lightBvh.pmf(pos, light);
+	return lightTable.pmf(light);
+}
+
 Vec3 Scene::sky(const Vec3& dir) {
+	if (envMap) return envMap->sample(dir);
+
 	float nl = dot(dir, -sunDir);
-	nl = max(nl, 0);
+	nl = std::max(nl, 0.0f);
 	nl *= nl;
 	nl *= nl;
 	nl *= nl;
@@ -61,56 +202,157 @@ Vec3 Scene::sky(const Vec3& dir) {
 	return (Vec3(1, 1, 1) + Vec3(-0.25, -0.25, 0.5) * dir.y) + sunColor * nl;
 }
 
-Vec3 Scene::lightDiffuse(Object* obj, const Vec3& pos, const Vec3& normal, Prng& prng) {
-	int i = prng.frand(0, lights.size());
-	if (i >= lights.size()) i = lights.size() - 1;
-	if (lights[i] == obj) return Vec3(0, 0, 0);
+LightSample Scene::sampleLights(ObjectRef obj, const Vec3& pos, float time, Prng& prng) {
+	LightSample result;
+	float pmf;
+	int i = pickLight(pos, prng, pmf);
+	if (lights[i] == obj) return result;
 
-	auto randomPoint = lights[i]->getRandomPoint(prng);
-	auto lightDir = randomPoint - pos;
-	auto ddn = dot(lightDir, normal);
-	if (ddn < 0) return Vec3(0, 0, 0);
+	auto& light = object(lights[i]);
+	auto s = visit(lights[i], [&](auto& o) { return o.sampleSurface(prng, time); });
+	float area = visit(lights[i], [](auto& o) { return o.getSurfaceArea(); });
+	auto lightDir = s.position - pos;
 	auto l = length(lightDir);
 	lightDir /= l;
-	ddn /= l;
-	Ray ray(pos, lightDir);
-	Hit hit;
-	if (!intersect(ray, &hit) || hit.obj == lights[i]) {
-		return (ddn * lights[i]->material->sample(randomPoint, Vec3(0, 0, 0)).emission / (1 + l * l)) * lights[i]->getSurfaceArea() / M_PI * lights.size();
+
+	// lights emit on both sides, like when hit by a bounce ray
+	auto dln = fabsf(dot(lightDir, s.normal));
+	if (dln <= 0) return result;
+
+	// area pdf 1/area converted to solid angle
+	result.direction = lightDir;
+	result.radiance = g_materials.evaluate(light.material, s.position, s.uvw).emission;
+	result.distance = l * 0.999f;
+	result.pdf = pmf * l * l / (dln * area);
+	return result;
+}
+
+LightSample Scene::sampleEnvironment(Prng& prng) {
+	LightSample result;
+	result.direction = envMap->sampleDirection(prng, result.pdf);
+	result.radiance = envMap->sample(result.direction);
+	result.distance = std::numeric_limits<float>::max();
+	return result;
+}
+
+int Scene::lightIndex(const Hit& hit) {
+	if (hit.obj.type == ObjectType::Instance) {
+		auto& triangleLights = instances[hit.obj.index].triangleLights;
+		return hit.primitive < triangleLights.size() ? triangleLights[hit.primitive] : -1;
 	}
-	return Vec3(0, 0, 0);
+	return object(hit.obj).light;
 }
 
-Vec3 Scene::lightSpecular(Object* obj, const Vec3& pos, const Vec3& direction, float roughness, Prng& prng) {
-	int i = prng.frand(0, lights.size() - 1);
-	if (lights[i] == obj) return Vec3(0, 0, 0);
+float Scene::lightPdf(const Hit& hit, const Vec3& pos, const Vec3& dir) {
+	int i = lightIndex(hit);
+	if (i < 0) return 0;
 
-	auto randomPoint = lights[i]->getRandomPoint(prng);
-	auto lightDir = randomPoint - pos;
-	auto dld = dot(lightDir, direction);
-	if (dld < 0) return Vec3(0, 0, 0);
-	auto l = length(lightDir);
-	lightDir /= l;
-	dld /= l;
-	Ray ray(pos, lightDir);
+	float area = visit(lights[i], [](auto& o) { return o.getSurfaceArea(); });
+	float dln = fabsf(dot(dir, hit.normal));
+	if (dln <= 0) return 0;
+	return lightPmf(pos, i) * hit.distance * hit.distance / (dln * area);
+}
 
-	Hit hit;
-	hit.distance = l;
-	if (!intersect(ray, &hit) || hit.obj == lights[i]) {
-		return pow(dld, 1.0f + (1.0f - roughness) * 1000) / (1.0f + roughness * 10) * lights[i]->material->sample(randomPoint, Vec3(0, 0, 0)).emission + lights.size();
+thread_local long long numrays = 0;
+
+template<typename T>
+bool intersectAll(std::vector<T>& prims, ObjectType type, const Ray& ray, Hit* hit) {
+	bool found = false;
+	for (size_t i = 0; i < prims.size(); i++) {
+		if (prims[i].intersect(ray, hit)) {
+			if (!hit) return true;
+			hit->obj = ObjectRef(type, i);
+			found = true;
+		}
 	}
-	return Vec3(0, 0, 0);
+	return found;
 }
 
-thread_local int numrays = 0;
-
 bool Scene::intersect(const Ray& ray, Hit* hit) {
 	numrays++;
 	bool found = false;
 
-	for (auto& object: objects) {
-		found |= object->intersect(ray, hit);
+	if (dirty) {
+		// acceleration structures are out of date, test everything
+		found |= intersectAll(spheres, ObjectType::Sphere, ray, hit);
+		found |= intersectAll(quads, ObjectType::Quad, ray, hit);
+		found |= intersectAll(instances, ObjectType::Instance, ray, hit);
 	}
+	else {
+		float tmin = hit ? hit->minDistance : 0;
+		float tmax = hit ? hit->distance : std::numeric_limits<float>::max();
+
+		int i = sphereBvh.intersect(ray, tmin, tmax, !hit);
+		if (i >= 0) {
+			if (!hit) return true;
+			auto& sphere = spheres[i];
+			hit->distance = tmax;
+			hit->material = sphere.material;
+			hit->normal = sphere.getNormal(ray.origin + ray.direction * tmax, ray.time);
+			hit->obj = ObjectRef(ObjectType::Sphere, i);
+			found = true;
+		}
+
+		i = quadBvh.intersect(ray, tmin, tmax, !hit);
+		if (i >= 0) {
+			if (!hit) return true;
+			auto& quad = quads[i];
+			hit->distance = tmax;
+			hit->material = quad.material;
+			hit->normal = quad.getNormal(ray.origin + ray.direction * tmax);
+			hit->obj = ObjectRef(ObjectType::Quad, i);
+			found = true;
+		}
+
+		found |= instanceBvh.traverse(ray, tmin, tmax, !hit, [&](const IndexBatch& batch, float& limit) {
+			bool isHit = false;
+			for (int k = 0; k < batch.count; k++) {
+				uint32_t index = batch.index[k];
+				if (!instances[index].intersect(ray, hit)) continue;
+				if (!hit) return true;
+				limit = hit->distance;
+				hit->obj = ObjectRef(ObjectType::Instance, index);
+				isHit = true;
+			}
+			return isHit;
+		});
+		if (found && !hit) return true;
+	}
+
+	found |= intersectAll(cubes, ObjectType::Cube, ray, hit);
+	found |= intersectAll(planes, ObjectType::Plane, ray, hit);
 
 	return found;
+}
+
+template<typename T>
+bool occludedAny(const std::vector<T>& prims, const Ray& ray, float tMax) {
+	for (auto& prim : prims) {
+		if (prim.occluded(ray, tMax)) return true;
+	}
+	return false;
+}
+
+bool Scene::occluded(const Ray& ray, float tMax) {
+	numrays++;
+
+	if (dirty) {
+		if (occludedAny(spheres, ray, tMax)) return true;
+		if (occludedAny(quads, ray, tMax)) return true;
+		if (occludedAny(instances, ray, tMax)) return true;
+	}
+	else {
+		float distance = tMax;
+		if (sphereBvh.intersect(ray, kMinDistance, distance, true) >= 0) return true;
+		if (quadBvh.intersect(ray, kMinDistance, distance, true) >= 0) return true;
+		bool blocked = instanceBvh.traverse(ray, kMinDistance, distance, true, [&](const IndexBatch& batch, float& limit) {
+			for (int k = 0; k < batch.count; k++) {
+				if (instances[batch.index[k]].occluded(ray, limit)) return true;
+			}
+			return false;
+		});
+		if (blocked) return true;
+	}
+
+	return occludedAny(cubes, ray, tMax) || occludedAny(planes, ray, tMax);
 }
\ No newline at end of file
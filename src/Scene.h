@@ -4,38 +4,125 @@
 #include "Sphere.h"
 #include "Plane.h"
 #include "Cube.h"
+#include "Quad.h"
 #include "Mesh.h"
+#include "Instance.h"
+#include "TriangleLight.h"
+#include "ObjectRef.h"
+#include "Bvh.h"
+#include "Batch.h"
+#include "LightBvh.h"
+#include "Distribution.h"
 
 #include <vector>
+#include <utility>
 
 struct Ray;
 struct Hit;
 struct EnvironmentMap;
 class Prng;
 
+// How next event estimation picks a light. Power uses an alias table and is
+// O(1) but ignores where the lights are, Spatial walks the light BVH and
+// weights lights by power over squared distance to the shading point.
+enum class LightSelection {
+	Power,
+	Spatial,
+};
+
+// A direction from a shading point towards an emitter.
+struct LightSample {
+	Vec3 direction;
+	Vec3 radiance;
+	float distance = 0; // to the sampled point, for the shadow ray
+	float pdf = 0;      // per solid angle including light selection, 0 if unusable
+};
+
 class Scene {
 public:
     Scene();
     bool intersect(const Ray& ray, Hit* hit = nullptr);
-    Vec3 lightDiffuse(Object* obj, const Vec3& pos, const Vec3& normal, Prng& prng);
-	Vec3 lightSpecular(Object* obj, const Vec3& pos, const Vec3& direction, float roughness, Prng& prng);
+	// Any-hit query for shadow rays, true if anything blocks the ray before tMax.
+	bool occluded(const Ray& ray, float tMax);
+	void build();
+	// Updates the acceleration structures after spheres, quads or instances
+	// were moved in place or meshes refitted, in a fraction of the time of a
+	// full build. Falls back to build() when objects were added.
+	void refit();
+	// Samples a point on one of the lights where it is at time, obj is the
+	// object being shaded. Visibility is left to the caller.
+	LightSample sampleLights(ObjectRef obj, const Vec3& pos, float time, Prng& prng);
+	LightSample sampleEnvironment(Prng& prng);
+	// Solid angle density of sampleLights producing the emitter hit from pos
+	// in direction dir, 0 if the hit surface is not a sampled light.
+	float lightPdf(const Hit& hit, const Vec3& pos, const Vec3& dir);
+	int lightIndex(const Hit& hit);
+	int pickLight(const Vec3& pos, Prng& prng, float& pmf);
+	float lightPmf(const Vec3& pos, int light);
     Vec3 sky(const Vec3& dir);
-	
-	void addLight(Object* o) {
-		o->isLight = true;
+
+	ObjectRef add(const Sphere& sphere);
+	ObjectRef add(const Quad& quad);
+	ObjectRef add(const Cube& cube);
+	ObjectRef add(const Plane& plane);
+	ObjectRef add(const Instance& instance);
+	ObjectRef add(Mesh* mesh);
+	void addMeshLights(ObjectRef instance);
+	void clear();
+
+	// Calls f with the concrete primitive referenced by ref.
+	template<typename F>
+	auto visit(ObjectRef ref, F&& f) -> decltype(f(std::declval<Sphere&>())) {
+		switch (ref.type) {
+		case ObjectType::Sphere: return f(spheres[ref.index]);
+		case ObjectType::Quad: return f(quads[ref.index]);
+		case ObjectType::Cube: return f(cubes[ref.index]);
+		case ObjectType::Plane: return f(planes[ref.index]);
+		case ObjectType::Triangle: return f(triangleLights[ref.index]);
+		default: return f(instances[ref.index]);
+		}
+	}
+
+	Object& object(ObjectRef ref) {
+		return visit(ref, [](Object& o) -> Object& { return o; });
+	}
+
+	void addLight(ObjectRef o) {
+		object(o).isLight = true;
+		object(o).light = lights.size();
 		lights.push_back(o);
+		dirty = true;
 	}
 	
 	bool hasLights() {
 		return !lights.empty();
 	}
 
+private:
+	void buildLights();
+	void findMotion();
+
 public:
-    std::vector<Object*> objects;
-	std::vector<Object*> lights;
+	std::vector<Sphere> spheres;
+	std::vector<Quad> quads;
+	std::vector<Cube> cubes;
+	std::vector<Plane> planes;
+	std::vector<Instance> instances;
+	std::vector<TriangleLight> triangleLights;
+	std::vector<ObjectRef> lights;
+	BatchBvh<SphereBatch> sphereBvh;
+	BatchBvh<QuadBatch> quadBvh;
+	BatchBvh<IndexBatch> instanceBvh;
+	AliasTable lightTable;
+	LightBvh lightBvh;
+	LightSelection lightSelection = LightSelection::Spatial;
+	bool dirty = true;
+	// Some object moves while the shutter is open, so camera rays get a
+	// random time. Found by build and refit.
+	bool moving = false;
 	EnvironmentMap* envMap = nullptr;
 	Vec3 sunDir;
 	Vec3 sunColor;
 };
 
-#endif
\ No newline at end of file
+#endif
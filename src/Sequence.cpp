@@ -0,0 +1,143 @@
+#include "Sequence.h"
+#include "Tracer.h"
+#include "Camera.h"
+#include "HdrImage.h"
+#include "mathutils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+const float kDegrees = 3.14159265f / 180;
+
+void fail(int line, const std::string& message) {
+	throw std::runtime_error("camera path line " + std::to_string(line) + ": " + message);
+}
+
+bool endsWith(const std::string& s, const std::string& suffix) {
+	return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}
+
+void writeFrame(const Tracer& tracer, const std::string& filename, float exposure) {
+	HdrImage image;
+	image.width = tracer.width;
+	image.height = tracer.height;
+	image.pixels.resize(size_t(tracer.width) * tracer.height);
+	float scale = tracer.numSamples > 0 ? 1.0f / tracer.numSamples : 0;
+	for (size_t i = 0; i < image.pixels.size(); i++) image.pixels[i] = tracer.buffer[i] * scale;
+	writeImage(image, filename, exposure);
+}
+
+void writeImage(const HdrImage& image, const std::string& filename, float exposure) {
+	std::ofstream file(filename, std::ios::binary);
+	if (!file) throw std::runtime_error(filename + ": cannot open for writing");
+
+	if (endsWith(filename, ".hdr")) {
+		writeHdr(file, image);
+	}
+	else {
+		// same tonemap as the interactive view
+		file << "P6\n" << image.width << " " << image.height << "\n255\n";
+		std::vector<uint8_t> bytes;
+		bytes.reserve(image.pixels.size() * 3);
+		for (auto& c : image.pixels) {
+			bytes.push_back(uint8_t(sqrtf(clamp01(c.x * exposure)) * 255));
+			bytes.push_back(uint8_t(sqrtf(clamp01(c.y * exposure)) * 255));
+			bytes.push_back(uint8_t(sqrtf(clamp01(c.z * exposure)) * 255));
+		}
+		file.write((const char*)bytes.data(), bytes.size());
+	}
+	if (!file) throw std::runtime_error(filename + ": write failed");
+}
+
+void CameraPath::apply(float frame, Camera& camera) const {
+	if (keys.empty()) return;
+
+	size_t next = 0;
+	while (next < keys.size() && keys[next].frame <= frame) next++;
+	auto& a = keys[next > 0 ? next - 1 : 0];
+	auto& b = keys[std::min(next, keys.size() - 1)];
+	float t = b.frame > a.frame ? (frame - a.frame) / (b.frame - a.frame) : 0;
+	t = std::min(std::max(t, 0.0f), 1.0f);
+
+	camera.position = lerp(a.position, b.position, t);
+	camera.yaw = a.yaw + (b.yaw - a.yaw) * t;
+	camera.pitch = a.pitch + (b.pitch - a.pitch) * t;
+	camera.focalLength = a.focalLength + (b.focalLength - a.focalLength) * t;
+	camera.apertureSize = a.apertureSize + (b.apertureSize - a.apertureSize) * t;
+}
+
+int CameraPath::frameCount() const {
+	return keys.empty() ? 0 : int(floorf(keys.back().frame)) + 1;
+}
+
+CameraPath readCameraPath(std::istream& file) {
+	CameraPath path;
+	CameraKey key;
+	std::string text;
+	int line = 0;
+	while (std::getline(file, text)) {
+		line++;
+		std::istringstream stream(text);
+		stream >> std::ws;
+		if (stream.eof() || stream.peek() == '#') continue;
+
+		float values[8];
+		int count = 0;
+		while (count < 8 && stream >> values[count]) count++;
+		if (!(stream >> std::ws).eof()) fail(line, "expected up to 8 numbers");
+		if (count < 4) fail(line, "expected a frame and a position");
+
+		key.frame = values[0];
+		key.position = Vec3(values[1], values[2], values[3]);
+		if (count > 4) key.yaw = values[4] * kDegrees;
+		if (count > 5) key.pitch = values[5] * kDegrees;
+		if (count > 6) key.focalLength = values[6];
+		if (count > 7) key.apertureSize = values[7];
+		if (!path.keys.empty() && key.frame <= path.keys.back().frame) fail(line, "frames must increase");
+		path.keys.push_back(key);
+	}
+	if (path.keys.empty()) throw std::runtime_error("camera path has no keys");
+	return path;
+}
+
+std::string frameFilename(const std::string& pattern, int frame) {
+	auto name = pattern;
+	auto last = name.rfind('#');
+	if (last == std::string::npos) {
+		// no placeholder, number the frames before the extension
+		auto dot = name.rfind('.');
+		auto slash = name.find_last_of("/\\");
+		last = dot != std::string::npos && (slash == std::string::npos || dot > slash) ? dot : name.size();
+		name.insert(last, "####");
+		last += 3;
+	}
+	auto first = last;
+	while (first > 0 && name[first - 1] == '#') first--;
+	int width = int(last - first + 1);
+
+	char number[32];
+	snprintf(number, sizeof(number), "%0*d", width, frame);
+	return name.replace(first, width, number);
+}
+
+void renderSequence(Tracer& tracer, const CameraPath& path, const SequenceSettings& settings) {
+	int frames = settings.frames > 0 ? settings.frames : path.frameCount();
+	for (int frame = 0; frame < frames; frame++) {
+		path.apply(float(frame), tracer.camera);
+		tracer.clear();
+		auto stats = renderUntil(tracer, settings.limits);
+
+		auto filename = frameFilename(settings.output, frame);
+		writeFrame(tracer, filename, settings.exposure);
+		printf("frame %d/%d %s: %s\n", frame + 1, frames, filename.c_str(), describe(stats).c_str());
+		fflush(stdout);
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef Sequence_h
+#define Sequence_h
+
+#include "Vec3.h"
+#include "RenderLimits.h"
+
+#include <istream>
+#include <string>
+#include <vector>
+
+class Camera;
+class Tracer;
+struct HdrImage;
+
+// Camera state at one frame of a path.
+struct CameraKey {
+	float frame = 0;
+	Vec3 position;
+	float yaw = 0;   // radians
+	float pitch = 0; // radians
+	float focalLength = 5;
+	float apertureSize = 0;
+};
+
+// Keyframed camera path, interpolated linearly between keys.
+struct CameraPath {
+	std::vector<CameraKey> keys; // by increasing frame
+
+	// Poses the camera at frame, holding the first and last key outside their range.
+	void apply(float frame, Camera& camera) const;
+	// Frames up to and including the last key.
+	int frameCount() const;
+};
+
+// Reads one key per line: frame, position x y z, yaw and pitch in degrees,
+// focal length and aperture size. Blank lines and lines starting with #
+// are skipped, missing trailing values keep those of the previous key.
+// Throws std::runtime_error on malformed lines or keys out of order.
+CameraPath readCameraPath(std::istream& file);
+
+struct SequenceSettings {
+	int frames = 0; // 0 renders up to the last key
+	RenderLimits limits; // per frame
+	// Output file name, a run of # is replaced by the zero padded frame
+	// number. The extension selects the format, .hdr for linear Radiance
+	// files and anything else for tonemapped binary PPM.
+	std::string output = "frame####.ppm";
+	float exposure = 1;
+};
+
+// Renders every frame of the path with tracer and writes one file per
+// frame. The scene and its acceleration structures are built once and
+// reused; each frame only moves the camera and clears the accumulation
+// buffer. Throws std::runtime_error if a file cannot be written.
+void renderSequence(Tracer& tracer, const CameraPath& path, const SequenceSettings& settings);
+
+// Writes the tracer's image averaged over its samples, as .hdr or PPM by
+// extension like the frames of a sequence.
+void writeFrame(const Tracer& tracer, const std::string& filename, float exposure = 1);
+void writeImage(const HdrImage& image, const std::string& filename, float exposure = 1);
+
+// Output name for one frame, see SequenceSettings::output.
+std::string frameFilename(const std::string& pattern, int frame);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef Simd_h
+#define Simd_h
+
+// Thin wrapper over the widest float vector the target supports so kernels
+// can be written once. 8 lanes with AVX, 4 with SSE, 1 otherwise.
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_SSE
+#endif
+
+#include <cmath>
+
+#if defined(SIMD_AVX)
+
+typedef __m256 vfloat;
+const int kSimdWidth = 8;
+
+inline vfloat vload(const float* p) { return _mm256_loadu_ps(p); }
+inline void vstore(float* p, vfloat a) { _mm256_storeu_ps(p, a); }
+inline vfloat vset1(float f) { return _mm256_set1_ps(f); }
+inline vfloat vadd(vfloat a, vfloat b) { return _mm256_add_ps(a, b); }
+inline vfloat vsub(vfloat a, vfloat b) { return _mm256_sub_ps(a, b); }
+inline vfloat vmul(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+inline vfloat vdiv(vfloat a, vfloat b) { return _mm256_div_ps(a, b); }
+inline vfloat vsqrt(vfloat a) { return _mm256_sqrt_ps(a); }
+inline vfloat vabs(vfloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+inline vfloat vlt(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline vfloat vle(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+inline vfloat vge(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+inline vfloat vand(vfloat a, vfloat b) { return _mm256_and_ps(a, b); }
+inline vfloat vselect(vfloat mask, vfloat a, vfloat b) { return _mm256_blendv_ps(b, a, mask); }
+inline int vmask(vfloat a) { return _mm256_movemask_ps(a); }
+
+#elif defined(SIMD_SSE)
+
+typedef __m128 vfloat;
+const int kSimdWidth = 4;
+
+inline vfloat vload(const float* p) { return _mm_loadu_ps(p); }
+inline void vstore(float* p, vfloat a) { _mm_storeu_ps(p, a); }
+inline vfloat vset1(float f) { return _mm_set1_ps(f); }
+inline vfloat vadd(vfloat a, vfloat b) { return _mm_add_ps(a, b); }
+inline vfloat vsub(vfloat a, vfloat b) { return _mm_sub_ps(a, b); }
+inline vfloat vmul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+inline vfloat vdiv(vfloat a, vfloat b) { return _mm_div_ps(a, b); }
+inline vfloat vsqrt(vfloat a) { return _mm_sqrt_ps(a); }
+inline vfloat vabs(vfloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+inline vfloat vlt(vfloat a, vfloat b) { return _mm_cmplt_ps(a, b); }
+inline vfloat vle(vfloat a, vfloat b) { return _mm_cmple_ps(a, b); }
+inline vfloat vge(vfloat a, vfloat b) { return _mm_cmpge_ps(a, b); }
+inline vfloat vand(vfloat a, vfloat b) { return _mm_and_ps(a, b); }
+inline vfloat vselect(vfloat mask, vfloat a, vfloat b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+inline int vmask(vfloat a) { return _mm_movemask_ps(a); }
+
+#else
+
+// Scalar fallback, masks are 0.0f or 1.0f.
+typedef float vfloat;
+const int kSimdWidth = 1;
+
+inline vfloat vload(const float* p) { return *p; }
+inline void vstore(float* p, vfloat a) { *p = a; }
+inline vfloat vset1(float f) { return f; }
+inline vfloat vadd(vfloat a, vfloat b) { return a + b; }
+inline vfloat vsub(vfloat a, vfloat b) { return a - b; }
+inline vfloat vmul(vfloat a, vfloat b) { return a * b; }
+inline vfloat vdiv(vfloat a, vfloat b) { return a / b; }
+inline vfloat vsqrt(vfloat a) { return sqrtf(a); }
+inline vfloat vabs(vfloat a) { return fabsf(a); }
+inline vfloat vlt(vfloat a, vfloat b) { return a < b ? 1.0f : 0.0f; }
+inline vfloat vle(vfloat a, vfloat b) { return a <= b ? 1.0f : 0.0f; }
+inline vfloat vge(vfloat a, vfloat b) { return a >= b ? 1.0f : 0.0f; }
+inline vfloat vand(vfloat a, vfloat b) { return (a != 0 && b != 0) ? 1.0f : 0.0f; }
+inline vfloat vselect(vfloat mask, vfloat a, vfloat b) { return mask != 0 ? a : b; }
+inline int vmask(vfloat a) { return a != 0 ? 1 : 0; }
+
+#endif
+
+#endif
@@ -0,0 +1,159 @@
+#include "Socket.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+typedef SOCKET Handle;
+const Handle kInvalid = INVALID_SOCKET;
+
+void closeHandle(Handle h) {
+	closesocket(h);
+}
+
+struct WinsockInit {
+	WinsockInit() {
+		WSADATA data;
+		WSAStartup(MAKEWORD(2, 2), &data);
+	}
+	~WinsockInit() {
+		WSACleanup();
+	}
+};
+
+const WinsockInit winsock;
+#else
+typedef int Handle;
+const Handle kInvalid = -1;
+
+void closeHandle(Handle h) {
+	::close(h);
+}
+#endif
+
+void fail(const std::string& message) {
+	throw std::runtime_error("socket: " + message);
+}
+
+// Tiles are answered as soon as they arrive, don't hold small messages back.
+void setNoDelay(Handle h) {
+	int one = 1;
+	setsockopt(h, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+}
+
+}
+
+Socket::~Socket() {
+	close();
+}
+
+Socket::Socket(Socket&& other) {
+	std::swap(handle, other.handle);
+}
+
+Socket& Socket::operator=(Socket&& other) {
+	std::swap(handle, other.handle);
+	return *this;
+}
+
+Socket Socket::listen(uint16_t port) {
+	Socket s;
+	Handle h = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (h == kInvalid) fail("cannot create");
+	s.handle = h;
+
+	int one = 1;
+	setsockopt(h, SOL_SOCKET, SO_REUSEADDR, (const char*)&one, sizeof(one));
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (::bind(h, (const sockaddr*)&address, sizeof(address)) != 0) fail("cannot bind port " + std::to_string(port));
+	if (::listen(h, 16) != 0) fail("cannot listen on port " + std::to_string(port));
+	return s;
+}
+
+Socket Socket::connect(const std::string& host, uint16_t port) {
+	addrinfo hints = {};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* addresses = nullptr;
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0 || !addresses) {
+		fail("cannot resolve " + host);
+	}
+
+	Socket s;
+	for (auto a = addresses; a; a = a->ai_next) {
+		Handle h = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (h == kInvalid) continue;
+		if (::connect(h, a->ai_addr, (int)a->ai_addrlen) == 0) {
+			s.handle = h;
+			break;
+		}
+		closeHandle(h);
+	}
+	freeaddrinfo(addresses);
+	if (!s.isOpen()) fail("cannot connect to " + host + ":" + std::to_string(port));
+	setNoDelay(s.handle);
+	return s;
+}
+
+Socket Socket::accept() {
+	Handle h = ::accept(handle, nullptr, nullptr);
+	if (h == kInvalid) fail("accept failed");
+	Socket s;
+	s.handle = h;
+	setNoDelay(h);
+	return s;
+}
+
+void Socket::send(const void* data, size_t size) {
+	auto p = (const char*)data;
+	while (size > 0) {
+		int chunk = (int)std::min(size, size_t(1) << 30);
+#ifdef _WIN32
+		int sent = ::send(handle, p, chunk, 0);
+#else
+		int sent = (int)::send(handle, p, chunk, MSG_NOSIGNAL);
+#endif
+		if (sent <= 0) fail("connection lost while sending");
+		p += sent;
+		size -= sent;
+	}
+}
+
+void Socket::receive(void* data, size_t size) {
+	auto p = (char*)data;
+	while (size > 0) {
+		int chunk = (int)std::min(size, size_t(1) << 30);
+		int received = (int)::recv(handle, p, chunk, 0);
+		if (received <= 0) fail("connection lost while receiving");
+		p += received;
+		size -= received;
+	}
+}
+
+void Socket::close() {
+	if (isOpen()) closeHandle(handle);
+	handle = kInvalid;
+}
+
+bool Socket::isOpen() const {
+	return handle != kInvalid;
+}
@@ -0,0 +1,38 @@
+#ifndef Socket_h
+#define Socket_h
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Blocking TCP stream socket. Failures throw std::runtime_error.
+class Socket {
+public:
+	Socket() = default;
+	~Socket();
+	Socket(Socket&& other);
+	Socket& operator=(Socket&& other);
+	Socket(const Socket&) = delete;
+	Socket& operator=(const Socket&) = delete;
+
+	// Listens on all interfaces.
+	static Socket listen(uint16_t port);
+	static Socket connect(const std::string& host, uint16_t port);
+	Socket accept();
+
+	// Sends or receives exactly size bytes.
+	void send(const void* data, size_t size);
+	void receive(void* data, size_t size);
+	void close();
+
+	bool isOpen() const;
+
+private:
+#ifdef _WIN32
+	uintptr_t handle = ~uintptr_t(0);
+#else
+	int handle = -1;
+#endif
+};
+
+#endif
@@ -3,19 +3,36 @@
 #include "Hit.h"
 
 #include <cmath>
+#include <utility>
 
-bool Sphere::intersect(const Ray& ray, Hit* hit) {
-	auto oc = ray.origin - center;
+namespace {
 
-	auto det = dot(ray.direction, oc);
-	float a = -det;
-	det *= det;
-	det = det - dot(oc, oc) + radius * radius;
+// Both roots of the ray/sphere quadratic for a unit direction. The
+// discriminant is taken from the distance between the center and the ray
+// rather than b^2 - c, which cancels for spheres far from the origin and puts
+// hit points visibly off the surface, and the smaller root avoids a - b.
+bool sphereRoots(const Ray& ray, const Vec3& center, float radius, float& near, float& far) {
+	auto oc = ray.origin - center;
+	float b = dot(ray.direction, oc);
+	auto l = oc - ray.direction * b;
+	float det = radius * radius - dot(l, l);
 	if (det < 0) return false;
 
-	float b = ::sqrtf(det);
-	float near = a - b;
-	float far = a + b;
+	float q = b > 0 ? -b - ::sqrtf(det) : -b + ::sqrtf(det);
+	if (q == 0) return false;
+	float c = dot(oc, oc) - radius * radius;
+	near = c / q;
+	far = q;
+	if (near > far) std::swap(near, far);
+	return true;
+}
+
+}
+
+bool Sphere::intersect(const Ray& ray, Hit* hit) {
+	float near, far;
+	if (!sphereRoots(ray, centerAt(ray.time), radius, near, far)) return false;
+
 	float dist = near;
 	if (near < 0) dist = far;
 
@@ -25,16 +42,35 @@ bool Sphere::intersect(const Ray& ray, Hit* hit) {
 
 		hit->distance = dist;
 		hit->material = material;
-		hit->obj = this;
-		hit->normal = (ray.origin + ray.direction * dist - center) / radius;
+		hit->normal = getNormal(ray.origin + ray.direction * dist, ray.time);
 	}
 	return true;
 }
 
-Vec3 Sphere::getRandomPoint(Prng& prng) {
-	return center + prng.randomPointOnUnitSphere()*radius;
+bool Sphere::occluded(const Ray& ray, float tMax) const {
+	float near, far;
+	if (!sphereRoots(ray, centerAt(ray.time), radius, near, far)) return false;
+	return (near > kMinDistance && near < tMax) || (far > kMinDistance && far < tMax);
+}
+
+SurfaceSample Sphere::sampleSurface(Prng& prng, float time) {
+	auto n = prng.randomPointOnUnitSphere();
+	return { centerAt(time) + n * radius, n, Vec3(0, 0, 0) };
 }
 
 float Sphere::getSurfaceArea() {
 	return 4 * M_PI * radius*radius;
+}
+
+Vec3 Sphere::getNormal(const Vec3& pos, float time) const {
+	return (pos - centerAt(time)) / radius;
+}
+
+AABB Sphere::getBounds() const {
+	AABB aabb;
+	aabb.enclose(center - Vec3(radius));
+	aabb.enclose(center + Vec3(radius));
+	aabb.enclose(center + motion - Vec3(radius));
+	aabb.enclose(center + motion + Vec3(radius));
+	return aabb;
 }
\ No newline at end of file
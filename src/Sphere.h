@@ -3,17 +3,26 @@
 
 #include "Vec3.h"
 #include "Material.h"
-#include "Object.h"
+#include "Object.h"
+#include "AABB.h"
 
 struct Sphere: Object {
-    Vec3 center;
+    Vec3 center; // when the shutter opens
     float radius;
+    // Distance the center moves in a straight line while the shutter is open.
+    Vec3 motion = Vec3(0, 0, 0);
 
-    Sphere(const Vec3& center, float radius, Material* material): center(center), radius(radius) { this->material = material; }
+    Sphere(const Vec3& center, float radius, MaterialId material): center(center), radius(radius) { this->material = material; }
 
-	bool intersect(const Ray& ray, Hit* hit) final override;
-	Vec3 getRandomPoint(Prng& prng) final override;
-	float getSurfaceArea() final override;
+	bool intersect(const Ray& ray, Hit* hit);
+	// True if anything blocks the ray within (kMinDistance, tMax).
+	bool occluded(const Ray& ray, float tMax) const;
+	SurfaceSample sampleSurface(Prng& prng, float time = 0);
+	float getSurfaceArea();
+	Vec3 getNormal(const Vec3& pos, float time = 0) const;
+	Vec3 centerAt(float time) const { return center + motion * time; }
+	// Encloses the sphere over the whole shutter interval.
+	AABB getBounds() const;
 };
 
 #endif
\ No newline at end of file
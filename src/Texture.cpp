@@ -0,0 +1,169 @@
+#include "Texture.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int kTileSize = 4;
+
+// Polynomial fit of the sRGB transfer curve, within 0.5% of the exact decode.
+float decodeSrgb(float x) {
+	return x * (x * (x * 0.305306011f + 0.682171111f) + 0.012522878f);
+}
+
+// Packs an sRGB encoded color in [0, 1] into a texel as is.
+uint32_t packTexel(const Vec3& c) {
+	auto pack = [](float x) {
+		return uint32_t(std::min(std::max(x, 0.0f), 1.0f) * 255 + 0.5f);
+	};
+	return pack(c.x) | pack(c.y) << 8 | pack(c.z) << 16 | 0xffu << 24;
+}
+
+// Exact sRGB encode of a linear color.
+uint32_t encodeSrgb(const Vec3& c) {
+	auto encode = [](float x) {
+		x = std::min(std::max(x, 0.0f), 1.0f);
+		return x <= 0.0031308f ? x * 12.92f : 1.055f * powf(x, 1 / 2.4f) - 0.055f;
+	};
+	return packTexel(Vec3(encode(c.x), encode(c.y), encode(c.z)));
+}
+
+Vec3 decodeTexel(uint32_t t) {
+	return Vec3(
+		decodeSrgb((t & 0xff) / 255.0f),
+		decodeSrgb(((t >> 8) & 0xff) / 255.0f),
+		decodeSrgb(((t >> 16) & 0xff) / 255.0f)
+	);
+}
+
+int texelIndex(const Texture::Level& level, int x, int y) {
+	int tile = (y / kTileSize) * level.tilesX + x / kTileSize;
+	return tile * kTileSize * kTileSize + (y % kTileSize) * kTileSize + x % kTileSize;
+}
+
+uint32_t texel(const Texture::Level& level, int x, int y) {
+	return level.texels[texelIndex(level, x, y)];
+}
+
+// Lays out texels given row by row in tiles.
+Texture::Level makeLevel(int width, int height, const std::vector<uint32_t>& texels) {
+	Texture::Level level;
+	level.width = width;
+	level.height = height;
+	level.tilesX = (width + kTileSize - 1) / kTileSize;
+	int tilesY = (height + kTileSize - 1) / kTileSize;
+	level.texels.resize(level.tilesX * tilesY * kTileSize * kTileSize);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			level.texels[texelIndex(level, x, y)] = texels[y * width + x];
+		}
+	}
+	return level;
+}
+
+// Weighted sum of four texels. With SSE the red, green and blue bytes of all
+// four are decoded side by side in one register each.
+Vec3 blend(const uint32_t texels[4], const float weights[4]) {
+#if defined(SIMD_AVX) || defined(SIMD_SSE)
+	const __m128i packed = _mm_loadu_si128((const __m128i*)texels);
+	const __m128i byte = _mm_set1_epi32(0xff);
+	const __m128 w = _mm_loadu_ps(weights);
+	auto channel = [&](int shift) {
+		__m128 x = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, shift), byte)), _mm_set1_ps(1.0f / 255));
+		__m128 y = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(0.305306011f)), _mm_set1_ps(0.682171111f));
+		y = _mm_add_ps(_mm_mul_ps(x, y), _mm_set1_ps(0.012522878f));
+		float lanes[4];
+		_mm_storeu_ps(lanes, _mm_mul_ps(_mm_mul_ps(x, y), w));
+		return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	};
+	return Vec3(channel(0), channel(8), channel(16));
+#else
+	Vec3 result(0, 0, 0);
+	for (int i = 0; i < 4; i++) result += decodeTexel(texels[i]) * weights[i];
+	return result;
+#endif
+}
+
+}
+
+Texture::Texture(int width, int height, const std::vector<Vec3>& pixels) : width(width), height(height) {
+	powerOfTwo = (width & (width - 1)) == 0 && (height & (height - 1)) == 0;
+
+	// the full resolution level keeps the source bytes, converting them back
+	// and forth would shift them with the approximate decode
+	std::vector<uint32_t> texels(pixels.size());
+	for (size_t i = 0; i < pixels.size(); i++) texels[i] = packTexel(pixels[i]);
+	levels.push_back(makeLevel(width, height, texels));
+	if (!powerOfTwo) return;
+
+	std::vector<Vec3> linear(pixels.size());
+	for (size_t i = 0; i < pixels.size(); i++) {
+		linear[i] = Vec3(decodeSrgb(pixels[i].x), decodeSrgb(pixels[i].y), decodeSrgb(pixels[i].z));
+	}
+
+	// box filtered mip chain down to 1x1, averaged in linear space
+	int w = width;
+	int h = height;
+	while (w > 1 || h > 1) {
+		int nw = std::max(w / 2, 1);
+		int nh = std::max(h / 2, 1);
+		std::vector<Vec3> next(nw * nh);
+		for (int y = 0; y < nh; y++) {
+			for (int x = 0; x < nw; x++) {
+				int x0 = x * w / nw, x1 = (x * w + w - 1) / nw;
+				int y0 = y * h / nh, y1 = (y * h + h - 1) / nh;
+				next[y * nw + x] = (linear[y0 * w + x0] + linear[y0 * w + x1] + linear[y1 * w + x0] + linear[y1 * w + x1]) * 0.25f;
+			}
+		}
+		linear.swap(next);
+		w = nw;
+		h = nh;
+		texels.resize(linear.size());
+		for (size_t i = 0; i < linear.size(); i++) texels[i] = encodeSrgb(linear[i]);
+		levels.push_back(makeLevel(w, h, texels));
+	}
+}
+
+int Texture::wrap(int i, int size) const {
+	if (powerOfTwo) return i & (size - 1);
+	i %= size;
+	return i < 0 ? i + size : i;
+}
+
+Vec3 Texture::bilinear(const Level& level, float u, float v) const {
+	float fx = u * level.width - 0.5f;
+	float fy = v * level.height - 0.5f;
+	float flx = floorf(fx);
+	float fly = floorf(fy);
+	float tx = fx - flx;
+	float ty = fy - fly;
+	int x0 = wrap(int(flx), level.width);
+	int x1 = wrap(int(flx) + 1, level.width);
+	int y0 = wrap(int(fly), level.height);
+	int y1 = wrap(int(fly) + 1, level.height);
+
+	const uint32_t texels[4] = { texel(level, x0, y0), texel(level, x1, y0), texel(level, x0, y1), texel(level, x1, y1) };
+	const float weights[4] = { (1 - tx) * (1 - ty), tx * (1 - ty), (1 - tx) * ty, tx * ty };
+	return blend(texels, weights);
+}
+
+Vec3 Texture::sample(float u, float v, float footprint, TextureFilter filter) const {
+	if (levels.empty()) return Vec3(0, 0, 0);
+
+	if (filter == TextureFilter::Nearest) {
+		auto& level = levels[0];
+		return decodeTexel(texel(level, wrap(int(floorf(u * width)), width), wrap(int(floorf(v * height)), height)));
+	}
+
+	float lod = 0;
+	if (filter == TextureFilter::Trilinear && footprint > 0) {
+		lod = std::min(std::max(log2f(footprint * std::max(width, height)), 0.0f), float(levels.size() - 1));
+	}
+	int l = int(lod);
+	float t = lod - l;
+	auto result = bilinear(levels[l], u, v);
+	if (t > 0) result = lerp(result, bilinear(levels[l + 1], u, v), t);
+	return result;
+}
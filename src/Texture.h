@@ -0,0 +1,48 @@
+#ifndef Texture_h
+#define Texture_h
+
+#include "Vec3.h"
+
+#include <cstdint>
+#include <vector>
+
+enum class TextureFilter {
+	Nearest,
+	Bilinear,
+	// bilinear on the two mip levels around the footprint, blended
+	Trilinear,
+};
+
+// 8-bit sRGB texture that wraps around at its edges. Colors are decoded to
+// linear on lookup. Power of two textures wrap with a mask and have a mip
+// chain, others wrap with a modulo and have a single level.
+struct Texture {
+	Texture() = default;
+	// pixels are sRGB encoded colors in [0, 1], row by row
+	Texture(int width, int height, const std::vector<Vec3>& pixels);
+
+	// Linear color at uv, where [0, 1) covers the texture once. footprint is
+	// the width of the lookup in uv units, it selects the mip level.
+	Vec3 sample(float u, float v, float footprint, TextureFilter filter) const;
+
+	// Texels are stored in 4x4 tiles of 64 bytes, so the 2x2 block of a
+	// bilinear lookup usually lies within one tile. The storage is not
+	// aligned, so a tile can still straddle two cache lines.
+	struct Level {
+		int width;
+		int height;
+		int tilesX;
+		std::vector<uint32_t> texels; // RGBA8, red in the low byte
+	};
+
+	int width = 0;
+	int height = 0;
+	bool powerOfTwo = false;
+	std::vector<Level> levels;
+
+private:
+	Vec3 bilinear(const Level& level, float u, float v) const;
+	int wrap(int i, int size) const;
+};
+
+#endif
@@ -5,13 +5,17 @@
 #include "Hit.h"
 #include "mathutils.h"
 #include "Prng.h"
+#include "EnvironmentMap.h"
+#include "Material.h"
+#include "Bsdf.h"
 
 #include <cmath>
 #include <cstring>
 #include <cstdlib>
+#include <algorithm>
 
 const int numThreads = 8;
-std::vector<Prng> prngs;
+
 Tracer::Tracer() {
 	camera.position = Vec3(0, 0, -3);
     camera.direction = Vec3(0,0,1);
@@ -24,103 +28,131 @@ Tracer::Tracer() {
 
 Tracer::~Tracer() {
     delete[] buffer;
+	delete[] squares;
 }
 
 void Tracer::resize(int newWidth, int newHeight) {
     delete[] buffer;
+	delete[] squares;
     numSamples = 0;
     width = newWidth;
     height = newHeight;
     buffer = new Vec3[width * height];
+	squares = new float[width * height];
 	clear();
 }
 
 void Tracer::clear() {
 	numSamples = 0;
+	squaredSamples = 0;
 	memset(buffer, 0, sizeof(Vec3) * width * height);
+	memset(squares, 0, sizeof(float) * width * height);
+}
+
+float Tracer::noise() const {
+	if (numSamples < 2 || squaredSamples < 2) return INFINITY;
+	double errors = 0;
+	double sum = 0;
+	for (int i = 0; i < width * height; i++) {
+		double mean = luminance(buffer[i]) / numSamples;
+		double variance = std::max(squares[i] / squaredSamples - mean * mean, 0.0);
+		errors += variance / (numSamples - 1);
+		sum += mean;
+	}
+	double pixels = double(width) * height;
+	return float(sqrt(errors / pixels) / std::max(sum / pixels, 1e-6));
+}
+
+// Light and environment samples at a scattering vertex, MIS weighted against
+// the bsdf sampling the same direction. normal is the geometric normal, time
+// that of the path.
+Vec3 directLight(Scene& scene, ObjectRef obj, const Vec3& position, const Vec3& normal, float time, const Vec3& wo, const Bsdf& bsdf, Prng& prng) {
+	Vec3 result(0, 0, 0);
+
+	auto add = [&](const LightSample& s) {
+		if (s.pdf <= 0) return;
+		float pdf = bsdf.pdf(wo, s.direction);
+		if (pdf <= 0) return;
+		if (scene.occluded(Ray(offsetRayOrigin(position, normal, s.direction), s.direction, time), s.distance)) return;
+		result += s.radiance * bsdf.eval(wo, s.direction) * (powerHeuristic(s.pdf, pdf) / s.pdf);
+	};
+
+	if (scene.hasLights()) add(scene.sampleLights(obj, position, time, prng));
+	if (scene.envMap) add(scene.sampleEnvironment(prng));
+	return result;
 }
 
-Vec3 Tracer::trace(const Ray& _ray, Prng& prng) {
+Vec3 Tracer::trace(const Ray& _ray, Prng& prng, float rouletteScale) {
     Vec3 emission(0, 0, 0);
     Vec3 transmission(1, 1, 1);
     Ray ray(_ray);
-	bool includeLights = true;
-	void* obj = nullptr;
+	// density of the bounce that produced ray, 0 if its vertex did no light sampling
+	float bsdfPdf = 0;
+	ObjectRef obj;
 	float ior = 1;
+	// ray cone around the path for texture filtering, starting at one pixel
+	float coneWidth = 0;
+	float coneSpread = pixelSpread;
 
 	int level = 0;
-    while (level++ < 5) {
+    while (level++ < settings.maxDepth) {
         Hit hit;
 		if (!scene.intersect(ray, &hit)) {
-			emission += scene.sky(ray.direction) * transmission;
+			float weight = 1;
+			if (bsdfPdf > 0 && scene.envMap) weight = powerHeuristic(bsdfPdf, scene.envMap->pdf(ray.direction));
+			emission += scene.sky(ray.direction) * transmission * weight;
 			break;
 		}
 
 		auto position = ray.origin + ray.direction * hit.distance;
 		auto normal = hit.normal;
 		if (dot(normal, ray.direction) > 0) normal *= -1;
-		auto material = hit.material->sample(position, hit.uvw);
-		if (includeLights || !hit.obj->isLight) emission += material.emission * transmission;
+		// interpolated normals only shade, and only where they face the ray like the surface does
+		auto shadingNormal = normal;
+		if (!(hit.shadingNormal == Vec3(0, 0, 0))) {
+			shadingNormal = dot(hit.shadingNormal, normal) < 0 ? -hit.shadingNormal : hit.shadingNormal;
+			if (dot(shadingNormal, ray.direction) >= 0) shadingNormal = normal;
+		}
+		coneWidth += coneSpread * hit.distance;
+		float footprint = coneWidth * hit.uvScale / std::max(-dot(normal, ray.direction), 0.1f);
+		auto material = g_materials.evaluate(hit.material, position, hit.uvw, footprint);
+		if (!(material.emission == Vec3(0, 0, 0))) {
+			float weight = 1;
+			if (bsdfPdf > 0 && scene.object(hit.obj).isLight) weight = powerHeuristic(bsdfPdf, scene.lightPdf(hit, ray.origin, ray.direction));
+			emission += material.emission * transmission * weight;
+		}
 
 		float iorout = (obj == hit.obj) ? 1 : material.ior;
+		Bsdf bsdf(material, shadingNormal, iorout / ior);
+		auto wo = -ray.direction;
 
-		float totalReflectivity = 0;// fresnel(ray.direction, normal, ior, iorout);
-		if (totalReflectivity > prng.frand(0, 1)) {
-			// total reflect
-			auto refl = reflect(ray.direction, normal);
-			if (false && material.roughness > 0.001f && scene.hasLights()) {
-				emission += transmission * scene.lightSpecular(hit.obj, position, refl, material.roughness, prng);
-				includeLights = false;
-			}
-			else includeLights = true;
-			ray.direction = prng.randomPointOnUnitHemisphere(refl, material.roughness);
-			ray.origin = position;
+		if (!bsdf.isDelta()) emission += transmission * directLight(scene, hit.obj, position, normal, ray.time, wo, bsdf, prng);
+
+		auto s = bsdf.sample(wo, prng);
+		if (s.weight == Vec3(0, 0, 0)) break;
+		transmission *= s.weight;
+		ray.origin = offsetRayOrigin(position, normal, s.direction);
+		ray.direction = s.direction;
+		bsdfPdf = s.pdf;
+		// a lobe with density p spreads the cone over a solid angle of about 1/p
+		if (s.pdf > 0) coneSpread = std::max(coneSpread, 1 / sqrtf(s.pdf));
+		if (dot(s.direction, normal) < 0) {
+			// refracted into or out of the object
+			ior = iorout;
+			obj = (obj == hit.obj) ? ObjectRef() : hit.obj;
 		}
-		else {
-			if (material.metallic > prng.frand(0, 1)) {
-				// metal reflect
-				auto refl = reflect(ray.direction, normal);
-				transmission *= material.color;
-				if (false && material.roughness > 0.001f && scene.hasLights()) {
-					emission += transmission * scene.lightSpecular(hit.obj, position, refl, material.roughness, prng);
-					includeLights = false;
-				}
-				else includeLights = true;
-				ray.direction = prng.randomPointOnUnitHemisphere(refl, material.roughness);
-				ray.origin = position;
-			}
-			else {
-				// dielectric
-				if (material.opacity > prng.frand(0, 1)) {
-					// diffuse scatter
-					transmission *= material.color;
-					if (scene.hasLights()) {
-						emission += transmission * scene.lightDiffuse(hit.obj, position, normal, prng);
-						includeLights = false;
-					}
-					else includeLights = true;
-					ray.origin = position;
-					ray.direction = prng.randomPointOnUnitHemisphereCosine(normal);
-				}
-				else {
-					// refract
-					ray.direction = refract(ray.direction, normal, ior, iorout);
-					ray.direction = prng.randomPointOnUnitHemisphere(ray.direction, material.roughness);
-					ray.origin = position;
-					ior = iorout;
-					transmission *= material.color;
-					includeLights = true;
-					obj = hit.obj;
-				}
-			}
-        }
 
-		//if (level < 2) continue;
+		if (level < settings.minDepth) continue;
 		
 		// Russian Roulette
 		// Randomly terminate a path with a probability inversely equal to the throughput
-		float p = std::max(transmission.x, std::max(transmission.y, transmission.z));
-		//p = p * p * p;
+		float p;
+		if (settings.roulette == RouletteStrategy::Efficiency) {
+			p = clamp(0.05f, 1, luminance(transmission) * rouletteScale);
+		}
+		else {
+			p = std::max(transmission.x, std::max(transmission.y, transmission.z));
+		}
 		if (prng.frand(0, 1) > p) {
 			break;
 		}
@@ -140,43 +172,91 @@ Ray Tracer::pixelToRay(int x, int y, float tanFov, Prng& prng) {
 	auto to = from + (camera.right * tanFov * fx + camera.up * tanFov * fy * height / width + camera.direction) * camera.focalLength;
 	from += prng.randomPointOnUnitDisc() * camera.apertureSize;
 	auto dir = normalized(to - from);
-	return Ray(from, dir);
+	return Ray(from, dir, scene.moving ? prng.frand(0, 1) : 0);
 }
 
-extern Tracer g_tracer;
-extern thread_local int numrays;
-int thread_num_rays[numThreads]{0};
+extern thread_local long long numrays;
+long long thread_num_rays[numThreads]{0};
 
-void threadfunc(int i, int n, Prng& prng) {
-	float tanFov = tanf(g_tracer.camera.horizontalFov / 2);
+void threadfunc(Tracer* tracer, int i, int n) {
+	float tanFov = tanf(tracer->camera.horizontalFov / 2);
 	numrays = 0;
-	for (int y = i; y < g_tracer.height; y += n) {
-		for (int x = 0; x < g_tracer.width; x++) {
-			g_tracer.buffer[y * g_tracer.width + x] += g_tracer.trace(g_tracer.pixelToRay(x, y, tanFov, prng), prng);
+	bool efficiency = tracer->settings.roulette == RouletteStrategy::Efficiency && tracer->numSamples > 0;
+	int sample = tracer->firstSample + tracer->numSamples;
+	for (int y = i; y < tracer->height; y += n) {
+		for (int x = 0; x < tracer->width; x++) {
+			auto prng = tracer->pixelPrng(x, y, sample);
+			auto& pixel = tracer->buffer[y * tracer->width + x];
+			float scale = 1;
+			if (efficiency) scale = tracer->imageMean / std::max(luminance(pixel) / tracer->numSamples, 1e-6f);
+			auto color = tracer->trace(tracer->pixelToRay(x, y, tanFov, prng), prng, scale);
+			pixel += color;
+			tracer->squares[y * tracer->width + x] += luminance(color) * luminance(color);
 		}
 	}
 	thread_num_rays[i] += numrays;
 	numrays = 0;
 }
 
-void Tracer::sample() {
+void Tracer::seed(unsigned int sd) {
+	randomSeed = sd;
+}
+
+Prng Tracer::pixelPrng(int x, int y, int sample) const {
+	return Prng((uint64_t(randomSeed) << 32) | uint32_t(sample), uint64_t(y) * width + x);
+}
+
+void Tracer::prepare() {
 	camera.direction = Vec3(sinf(camera.yaw)*cosf(camera.pitch), sinf(camera.pitch), cosf(camera.yaw)*cosf(camera.pitch));
 	camera.right = Vec3(cosf(camera.yaw), 0, -sinf(camera.yaw));
 	camera.up = cross(camera.direction, camera.right);
+	pixelSpread = tanf(camera.horizontalFov / 2) / width;
+
+	scene.build();
+}
 
-	if (prngs.empty()) {
-		for (int i = 0; i < numThreads; i++) {
-			prngs.push_back(Prng(rand()));
+void Tracer::renderTile(const Tile& tile, Vec3* out) {
+	prepare();
+	std::fill(out, out + tile.width * tile.height, Vec3(0, 0, 0));
+	float tanFov = tanf(camera.horizontalFov / 2);
+
+	auto rows = [&](int first) {
+		numrays = 0;
+		for (int row = first; row < tile.height; row += numThreads) {
+			int y = tile.y + row;
+			for (int s = 0; s < tile.samples; s++) {
+				for (int x = 0; x < tile.width; x++) {
+					auto prng = pixelPrng(tile.x + x, y, tile.firstSample + s);
+					out[row * tile.width + x] += trace(pixelToRay(tile.x + x, y, tanFov, prng), prng);
+				}
+			}
 		}
+		thread_num_rays[first] += numrays;
+		numrays = 0;
+	};
+
+	threads.clear();
+	for (int i = 0; i < numThreads; i++) threads.push_back(std::thread(rows, i));
+	for (auto& thread : threads) thread.join();
+}
+
+void Tracer::sample() {
+	prepare();
+
+	if (settings.roulette == RouletteStrategy::Efficiency && numSamples > 0) {
+		double sum = 0;
+		for (int i = 0; i < width * height; i++) sum += luminance(buffer[i]);
+		imageMean = sum / (double(width) * height * numSamples);
 	}
 
 	threads.clear();
 	for (int i = 0; i < numThreads; i++) {
-		threads.push_back(std::thread(threadfunc, i, numThreads, std::ref(prngs[i])));
+		threads.push_back(std::thread(threadfunc, this, i, numThreads));
 	}
 	for (int i = 0; i < numThreads; i++) {
 		threads[i].join();
 	}
 
 	numSamples++;
+	squaredSamples++;
 }
\ No newline at end of file
@@ -5,12 +5,37 @@
 #include "Camera.h"
 #include "Ray.h"
 #include "Vec3.h"
+#include "Prng.h"
 
 #include <thread>
+#include <vector>
 
 extern const int numThreads;
 
-class Prng;
+enum class RouletteStrategy {
+	// survive with the largest component of the path throughput
+	Throughput,
+	// survive with the throughput scaled by how dark the pixel is compared to
+	// the whole image, so bright pixels stop paths early and dark ones keep exploring
+	Efficiency,
+};
+
+// A rectangle of the image and a range of samples per pixel.
+struct Tile {
+	int x = 0;
+	int y = 0;
+	int width = 0;
+	int height = 0;
+	int firstSample = 0;
+	int samples = 0;
+};
+
+struct RenderSettings {
+	int maxDepth = 5;
+	// bounces before russian roulette may terminate a path
+	int minDepth = 1;
+	RouletteStrategy roulette = RouletteStrategy::Throughput;
+};
 
 class Tracer {
 public:
@@ -18,18 +43,45 @@ public:
     ~Tracer();
 
     void sample();
+	// Sums tile.samples samples of each pixel of the tile into out, row by
+	// row. Samples are numbered like those of sample(), so a tile matches the
+	// same pixels and samples of a whole image in any process. The efficiency
+	// roulette sees no image here and behaves like the throughput roulette.
+	void renderTile(const Tile& tile, Vec3* out);
+	// Orients the camera and builds the scene for the coming samples.
+	void prepare();
+	void seed(unsigned int sd);
+	// Random numbers of one sample of one pixel. They depend only on the seed,
+	// the pixel and the sample number, not on threads or which process renders.
+	Prng pixelPrng(int x, int y, int sample) const;
     void resize(int newWidth, int newHeight);
-    Vec3 trace(const Ray& ray, Prng& prng);
+	// rouletteScale is the image over pixel mean luminance, for the efficiency roulette.
+    Vec3 trace(const Ray& ray, Prng& prng, float rouletteScale = 1);
 	Ray pixelToRay(int x, int y, float tanFov, Prng& prng);
 	void clear();
+	// Relative standard error of the image: the RMS over pixels of the standard
+	// error of their mean luminance, over the mean luminance of the image.
+	// Infinite until two samples have gone into squares.
+	float noise() const;
 
 public:
 	std::vector<std::thread> threads;
     Camera camera;
+	RenderSettings settings;
     int width;
     int height;
     int numSamples = 0;
+	// number of the first sample in the buffer, so renders split into sample
+	// ranges draw different random numbers
+	int firstSample = 0;
+	unsigned int randomSeed = 0;
 	Vec3* buffer = nullptr;
+	// sums of squared sample luminance and the samples in them, fewer than
+	// numSamples after resuming from sums alone
+	float* squares = nullptr;
+	int squaredSamples = 0;
+	float imageMean = 0; // mean luminance of the buffer before the current sample
+	float pixelSpread = 0; // angle between the rays of neighbouring pixels
     Scene scene;
 };
 
@@ -0,0 +1,119 @@
+#include "Transform.h"
+
+#include <cmath>
+
+Transform::Transform() {
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 4; c++) {
+			m[r][c] = r == c ? 1.0f : 0.0f;
+		}
+	}
+}
+
+Transform Transform::translate(const Vec3& offset) {
+	Transform t;
+	t.m[0][3] = offset.x;
+	t.m[1][3] = offset.y;
+	t.m[2][3] = offset.z;
+	return t;
+}
+
+Transform Transform::scale(const Vec3& factor) {
+	Transform t;
+	t.m[0][0] = factor.x;
+	t.m[1][1] = factor.y;
+	t.m[2][2] = factor.z;
+	return t;
+}
+
+Transform Transform::rotate(const Vec3& axis, float angle) {
+	auto a = normalized(axis);
+	float s = sinf(angle);
+	float c = cosf(angle);
+	float ic = 1 - c;
+
+	Transform t;
+	t.m[0][0] = a.x * a.x * ic + c;
+	t.m[0][1] = a.x * a.y * ic - a.z * s;
+	t.m[0][2] = a.x * a.z * ic + a.y * s;
+	t.m[1][0] = a.y * a.x * ic + a.z * s;
+	t.m[1][1] = a.y * a.y * ic + c;
+	t.m[1][2] = a.y * a.z * ic - a.x * s;
+	t.m[2][0] = a.z * a.x * ic - a.y * s;
+	t.m[2][1] = a.z * a.y * ic + a.x * s;
+	t.m[2][2] = a.z * a.z * ic + c;
+	return t;
+}
+
+float Transform::determinant() const {
+	return
+		m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+		- m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+		+ m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+}
+
+Transform Transform::inverse() const {
+	float id = 1.0f / determinant();
+
+	Transform t;
+	t.m[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * id;
+	t.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * id;
+	t.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * id;
+	t.m[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) * id;
+	t.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * id;
+	t.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * id;
+	t.m[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * id;
+	t.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * id;
+	t.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * id;
+
+	// inverse translation is -R^-1 * t
+	for (int r = 0; r < 3; r++) {
+		t.m[r][3] = -(t.m[r][0] * m[0][3] + t.m[r][1] * m[1][3] + t.m[r][2] * m[2][3]);
+	}
+	return t;
+}
+
+Vec3 Transform::point(const Vec3& p) const {
+	return Vec3(
+		m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+		m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+		m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]
+	);
+}
+
+Vec3 Transform::vector(const Vec3& v) const {
+	return Vec3(
+		m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+		m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+		m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z
+	);
+}
+
+Vec3 Transform::transposedVector(const Vec3& v) const {
+	return Vec3(
+		m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z,
+		m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z,
+		m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z
+	);
+}
+
+Transform operator*(const Transform& a, const Transform& b) {
+	Transform t;
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 4; c++) {
+			t.m[r][c] = a.m[r][0] * b.m[0][c] + a.m[r][1] * b.m[1][c] + a.m[r][2] * b.m[2][c];
+		}
+		t.m[r][3] += a.m[r][3];
+	}
+	return t;
+}
+
+Transform lerp(const Transform& a, const Transform& b, float f) {
+	Transform t;
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 4; c++) {
+			t.m[r][c] = a.m[r][c] + (b.m[r][c] - a.m[r][c]) * f;
+		}
+	}
+	return t;
+}
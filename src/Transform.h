@@ -0,0 +1,30 @@
+#ifndef Transform_h
+#define Transform_h
+
+#include "Vec3.h"
+
+// Affine transform stored as the top three rows of a 4x4 matrix.
+struct Transform {
+	float m[3][4];
+
+	Transform();
+
+	static Transform translate(const Vec3& offset);
+	static Transform scale(const Vec3& factor);
+	static Transform rotate(const Vec3& axis, float angle);
+
+	Transform inverse() const;
+	float determinant() const;
+	Vec3 point(const Vec3& p) const;
+	Vec3 vector(const Vec3& v) const;
+	// Multiplies with the transposed 3x3 part. Applied to the inverse transform
+	// this maps object space normals to world space.
+	Vec3 transposedVector(const Vec3& v) const;
+};
+
+Transform operator*(const Transform& a, const Transform& b);
+// Element-wise blend, which moves every transformed point along a straight
+// line from its place under a to its place under b.
+Transform lerp(const Transform& a, const Transform& b, float f);
+
+#endif
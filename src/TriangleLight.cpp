@@ -0,0 +1,40 @@
+#include "TriangleLight.h"
+
+TriangleLight::TriangleLight(const Mesh* mesh, uint32_t index): mesh(mesh), index(index) {
+	material = mesh->triangles[index].material;
+}
+
+void TriangleLight::corners(float time, Vertex out[3]) const {
+	auto transform = moving && time > 0 ? lerp(toWorld, toWorldEnd, time) : toWorld;
+	auto& tri = mesh->triangles[index];
+	for (int k = 0; k < 3; k++) {
+		out[k] = mesh->vertices[tri.v[k]];
+		out[k].pos = transform.point(out[k].pos);
+	}
+}
+
+SurfaceSample TriangleLight::sampleSurface(Prng& prng, float time) {
+	float u0 = prng.frand(0, 1);
+	float u1 = prng.frand(0, 1);
+	Vertex v[3];
+	corners(time, v);
+	return sampleTriangle(v[0], v[1], v[2], u0, u1);
+}
+
+float TriangleLight::getSurfaceArea() {
+	Vertex v[3];
+	corners(0, v);
+	return triangleArea(v[0].pos, v[1].pos, v[2].pos);
+}
+
+AABB TriangleLight::getBounds() const {
+	Vertex v[3];
+	corners(0, v);
+	AABB aabb;
+	for (auto& vertex : v) aabb.enclose(vertex.pos);
+	if (moving) {
+		corners(1, v);
+		for (auto& vertex : v) aabb.enclose(vertex.pos);
+	}
+	return aabb;
+}
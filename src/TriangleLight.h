@@ -0,0 +1,36 @@
+#ifndef TriangleLight_h
+#define TriangleLight_h
+
+#include "Object.h"
+#include "Mesh.h"
+#include "AABB.h"
+#include "Transform.h"
+
+// An emissive mesh triangle, registered as an area light. Its corners are
+// read from the mesh through the triangle's indices and placed in world
+// space with the transforms of the instance it belongs to.
+// It is only sampled for next event estimation; rays hit the triangle
+// through the instance.
+struct TriangleLight : Object {
+	const Mesh* mesh;
+	uint32_t index; // in mesh->triangles
+	Transform toWorld; // when the shutter opens
+	// Placement when the shutter closes, only used when moving is set.
+	Transform toWorldEnd;
+	bool moving = false;
+
+	TriangleLight(const Mesh* mesh, uint32_t index);
+
+	SurfaceSample sampleSurface(Prng& prng, float time = 0);
+	// Area when the shutter opens, approximate at later times unless the
+	// instance only translates (see Instance::getSurfaceArea).
+	float getSurfaceArea();
+	// Encloses the triangle over the whole shutter interval.
+	AABB getBounds() const;
+
+private:
+	// The corners in world space at the given shutter time.
+	void corners(float time, Vertex out[3]) const;
+};
+
+#endif
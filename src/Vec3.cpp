@@ -134,10 +134,44 @@ Vec3 operator/(const Vec3& v, float f) {
     return Vec3(v.x / f, v.y / f, v.z / f);
 }
 
+float luminance(const Vec3& v) {
+    return 0.2126f * v.x + 0.7152f * v.y + 0.0722f * v.z;
+}
+
 Vec3 lerp(const Vec3& a, const Vec3& b, float f) {
     return a * (1.0f - f) + b * f;
 }
 
+uint32_t packNormal(const Vec3& n) {
+	// project onto the octahedron and fold the lower half over the corners
+	float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	float u = n.x / l1;
+	float v = n.y / l1;
+	if (n.z < 0) {
+		float fu = (1 - fabsf(v)) * (u < 0 ? -1 : 1);
+		float fv = (1 - fabsf(u)) * (v < 0 ? -1 : 1);
+		u = fu;
+		v = fv;
+	}
+	auto quantize = [](float f) {
+		return uint32_t(uint16_t(int16_t(lrintf(clamp(-1, 1, f) * 32767))));
+	};
+	return quantize(u) | quantize(v) << 16;
+}
+
+Vec3 unpackNormal(uint32_t packed) {
+	float u = int16_t(packed & 0xffff) / 32767.0f;
+	float v = int16_t(packed >> 16) / 32767.0f;
+	float z = 1 - fabsf(u) - fabsf(v);
+	if (z < 0) {
+		float fu = (1 - fabsf(v)) * (u < 0 ? -1 : 1);
+		float fv = (1 - fabsf(u)) * (v < 0 ? -1 : 1);
+		u = fu;
+		v = fv;
+	}
+	return normalized(Vec3(u, v, z));
+}
+
 Vec3 reflect(const Vec3& in, const Vec3& n) {
     return in - n * dot(in, n) * 2;
 }
@@ -1,6 +1,8 @@
 #ifndef Vec3_h
 #define Vec3_h
 
+#include <cstdint>
+
 struct Vec3 {
     float x, y, z;
 
@@ -22,6 +24,7 @@ float length(const Vec3& v);
 Vec3 normalized(const Vec3& v);
 Vec3 cross(const Vec3& a, const Vec3& b);
 float dot(const Vec3& a, const Vec3& b);
+float luminance(const Vec3& v);
 Vec3 boxnormal(const Vec3& p);
 
 Vec3 operator-(const Vec3& v);
@@ -39,4 +42,8 @@ Vec3 reflect(const Vec3& in, const Vec3& n);
 Vec3 refract(const Vec3& in, const Vec3& n, float ior1, float ior2);
 float fresnel(const Vec3& I, const Vec3& N, float ior1, float ior2);
 
+// Unit vector in 32 bits, as two signed 16-bit coordinates of its octahedral projection.
+uint32_t packNormal(const Vec3& n);
+Vec3 unpackNormal(uint32_t packed);
+
 #endif
\ No newline at end of file
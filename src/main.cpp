@@ -4,6 +4,7 @@
 #include "mathutils.h"
 #include "Prng.h"
 #include "Mesh.h"
+#include "Headless.h"
 
 #define SDL_MAIN_HANDLED
 #include <SDL2/SDL.h>
@@ -11,6 +12,8 @@
 #include <string>
 #include <chrono>
 #include <sstream>
+#include <stdexcept>
+#include <algorithm>
 
 bool g_stop = false;
 bool g_debug_read = false;
@@ -26,7 +29,7 @@ constexpr uint32_t rgba(unsigned char r, unsigned char g, unsigned char b, unsig
 	return a << 24 | r << 16 | g << 8 | b;
 }
 
-constexpr uint32_t rgba(const Vec3& c) {
+uint32_t rgba(const Vec3& c) {
 	return rgba(tonemap(c.x) * 255, tonemap(c.y) * 255, tonemap(c.z) * 255, 255);
 }
 
@@ -50,7 +53,7 @@ void updateScreen(SDL_Renderer* renderer, SDL_Texture* framebuffer) {
 	SDL_RenderPresent(renderer);
 }
 
-extern int thread_num_rays[8];
+extern long long thread_num_rays[8];
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -58,6 +61,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 #else
 int main(int argc, char** argv) {
 #endif
+#ifdef _WIN32
+	int argc = __argc;
+	char** argv = __argv;
+#endif
+
+	if (argc > 1) return runHeadless(g_tracer, argc, argv);
 
 	Prng prng(0);
 
@@ -117,7 +126,26 @@ int main(int argc, char** argv) {
 				else if (e.key.keysym.sym == SDLK_MINUS) {
 					exposure /= 1.5f;
 				}
+				else if (e.key.keysym.sym == SDLK_PAGEUP) {
+					g_tracer.settings.maxDepth++;
+					g_tracer.clear();
+				}
+				else if (e.key.keysym.sym == SDLK_PAGEDOWN) {
+					if (g_tracer.settings.maxDepth > 1) g_tracer.settings.maxDepth--;
+					g_tracer.clear();
+				}
+				else if (e.key.keysym.sym == SDLK_r) {
+					auto& roulette = g_tracer.settings.roulette;
+					roulette = roulette == RouletteStrategy::Throughput ? RouletteStrategy::Efficiency : RouletteStrategy::Throughput;
+					g_tracer.clear();
+				}
+				else if (e.key.keysym.sym == SDLK_t) {
+					auto& filter = g_materials.filter;
+					filter = filter == TextureFilter::Nearest ? TextureFilter::Bilinear : (filter == TextureFilter::Bilinear ? TextureFilter::Trilinear : TextureFilter::Nearest);
+					g_tracer.clear();
+				}
 				//g_tracer.scene.spheres[0].center = g_tracer.camera.position + Vec3(0, 0.5, 0);
+				//g_tracer.scene.refit();
 				break;
 				
             case SDL_WINDOWEVENT:
@@ -150,7 +178,7 @@ int main(int argc, char** argv) {
 				break;
 
 			case SDL_MOUSEWHEEL:
-				g_tracer.camera.apertureSize = max(0.0f, g_tracer.camera.apertureSize + 0.01f * e.wheel.y);
+				g_tracer.camera.apertureSize = std::max(0.0f, g_tracer.camera.apertureSize + 0.01f * e.wheel.y);
 				g_tracer.clear();
 				break;
 
@@ -176,7 +204,8 @@ int main(int argc, char** argv) {
 				rays += thread_num_rays[i];
 				thread_num_rays[i] = 0;
 			}
-			sstr << "Tracer | " << (rays / duration / 1000) << "MRays/s | " << duration << "ms/frame | " << g_tracer.width << "x" << g_tracer.height << " | " << numThreads << " Threads | " << g_tracer.numSamples << " samples | exposure: " << exposure;
+			sstr << "Tracer | " << (rays / duration / 1000) << "MRays/s | " << duration << "ms/frame | " << g_tracer.width << "x" << g_tracer.height << " | " << numThreads << " Threads | " << g_tracer.numSamples << " samples | exposure: " << exposure << " | depth: " << g_tracer.settings.maxDepth
+				<< (g_tracer.settings.roulette == RouletteStrategy::Efficiency ? " | efficiency roulette" : "");
 			SDL_SetWindowTitle(window, sstr.str().c_str());
         }
 	}
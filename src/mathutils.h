@@ -11,4 +11,10 @@ constexpr inline float clamp01(float val) {
     return (val < 0) ? 0 : ((val > 1) ? 1 : val);
 }
 
+// Multiple importance sampling weight of a sample drawn with density a
+// against a second strategy with density b.
+inline float powerHeuristic(float a, float b) {
+	return a * a / (a * a + b * b);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,14 @@
+// ray-headless: the headless modes of ray without SDL, for render farm
+// hosts without a display. Takes the same options as ray, see Headless.h.
+//
+// usage: ray-headless --frame frame.hdr | --sequence path.txt | --coordinator port
+//                     | --worker host:port | --job part.acc [options]
+
+#include "Headless.h"
+#include "Tracer.h"
+
+Tracer tracer;
+
+int main(int argc, char** argv) {
+	return runHeadless(tracer, argc, argv);
+}
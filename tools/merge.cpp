@@ -0,0 +1,89 @@
+// ray-merge: adds up the accumulation files of jobs that rendered disjoint
+// sample ranges of the same frame and writes the averaged image.
+//
+// usage: ray-merge [--out frame.hdr] [--exposure e] [--acc merged.acc] job1.acc job2.acc ...
+//
+// The output format follows the extension like the frames of a sequence,
+// .hdr for linear Radiance files and anything else for tonemapped PPM.
+// --acc also writes the merged sums, to be merged again later.
+
+#include "Accumulation.h"
+#include "HdrImage.h"
+#include "Sequence.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+	std::string output = "frame.hdr";
+	std::string merged;
+	float exposure = 1;
+	std::vector<std::string> inputs;
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			if (arg.compare(0, 2, "--") != 0) {
+				inputs.push_back(arg);
+				continue;
+			}
+			if (i + 1 >= argc) {
+				fprintf(stderr, "missing value for %s\n", arg.c_str());
+				return 1;
+			}
+			std::string value = argv[++i];
+			try {
+				if (arg == "--out") output = value;
+				else if (arg == "--acc") merged = value;
+				else if (arg == "--exposure") exposure = std::stof(value);
+				else {
+					fprintf(stderr, "unknown option %s\n", arg.c_str());
+					return 1;
+				}
+			}
+			catch (const std::logic_error&) {
+				// std::stof on a malformed or out of range number
+				throw std::runtime_error("bad value for " + arg + ": " + value);
+			}
+		}
+		if (inputs.empty()) {
+			fprintf(stderr, "usage: ray-merge [--out frame.hdr] [--exposure e] [--acc merged.acc] job1.acc job2.acc ...\n");
+			return 1;
+		}
+
+		Accumulation total;
+		for (auto& input : inputs) {
+			std::ifstream file(input, std::ios::binary);
+			if (!file) throw std::runtime_error(input + ": cannot open");
+			try {
+				total.merge(readAccumulation(file));
+			}
+			catch (const std::exception& e) {
+				throw std::runtime_error(input + ": " + e.what());
+			}
+		}
+		if (total.samples() == 0) throw std::runtime_error("no samples to merge");
+
+		HdrImage image;
+		image.width = total.width;
+		image.height = total.height;
+		image.pixels.resize(total.sum.size());
+		float scale = 1.0f / total.samples();
+		for (size_t i = 0; i < total.sum.size(); i++) image.pixels[i] = total.sum[i] * scale;
+		writeImage(image, output, exposure);
+
+		if (!merged.empty()) {
+			std::ofstream file(merged, std::ios::binary);
+			writeAccumulation(file, total);
+			if (!file) throw std::runtime_error(merged + ": write failed");
+		}
+		printf("%d files, %d samples per pixel, %dx%d -> %s\n", (int)inputs.size(), total.samples(), total.width, total.height, output.c_str());
+	}
+	catch (const std::exception& e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}